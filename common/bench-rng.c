@@ -0,0 +1,105 @@
+/* Cost of generating sort workloads
+ *
+ * Usage: bench-rng [elements]
+ *
+ * Times the old generators, the three 16-bit Wichmann-Hill streams of
+ * quiz2/test1.c and the rand() shuffle of quiz1/test3.c, against rng.h on
+ * the same number of elements (default 1e8).
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "rng.h"
+
+static double now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec * 1e-6;
+}
+
+/* As quiz2/test1.c had it */
+static inline uint8_t getnum(void)
+{
+    static uint16_t s1 = UINT16_C(2);
+    static uint16_t s2 = UINT16_C(1);
+    static uint16_t s3 = UINT16_C(1);
+
+    s1 *= UINT16_C(171);
+    s1 %= UINT16_C(30269);
+    s2 *= UINT16_C(172);
+    s2 %= UINT16_C(30307);
+    s3 *= UINT16_C(170);
+    s3 %= UINT16_C(30323);
+    return s1 ^ s2 ^ s3;
+}
+
+static uint64_t sink;
+
+static void report(const char *name, size_t n, double ms)
+{
+    printf("%-28s %10.1f ms %8.2f ns/elem\n", name, ms, ms * 1e6 / n);
+}
+
+int main(int argc, char **argv)
+{
+    size_t n = argc > 1 ? strtoul(argv[1], NULL, 0) : 100000000;
+    uint64_t *words = malloc(n * sizeof(*words));
+    uint32_t *ints = malloc(n * sizeof(*ints));
+    rng_t r;
+    double t;
+
+    if (!words || !ints)
+        return 1;
+    rng_seed(&r, 1);
+    /* Fault the pages in first, so that no timing includes it */
+    memset(words, 0, n * sizeof(*words));
+    memset(ints, 0, n * sizeof(*ints));
+
+    t = now_ms();
+    for (size_t i = 0; i < n; i++)
+        ints[i] = (uint16_t) (getnum() << 8 | getnum());
+    report("getnum() 16-bit", n, now_ms() - t);
+
+    t = now_ms();
+    for (size_t i = 0; i < n; i++)
+        words[i] = rng_next(&r);
+    report("rng_next() loop", n, now_ms() - t);
+
+    t = now_ms();
+    rng_fill(&r, words, n);
+    report("rng_fill()", n, now_ms() - t);
+
+    t = now_ms();
+    rng_fill_bounded(&r, ints, n, 1000);
+    report("rng_fill_bounded(1000)", n, now_ms() - t);
+
+    for (size_t i = 0; i < n; i++)
+        ints[i] = i;
+
+    /* quiz1/test3.c's shuffle; RAND_MAX is 2^31 - 1 with glibc */
+    t = now_ms();
+    for (size_t i = 0; i + 1 < n; i++) {
+        size_t j = i + rand() / (RAND_MAX / (n - i) + 1);
+        uint32_t tmp = ints[j];
+        ints[j] = ints[i];
+        ints[i] = tmp;
+    }
+    report("rand() shuffle", n, now_ms() - t);
+
+    t = now_ms();
+    rng_shuffle(&r, ints, n, sizeof(ints[0]));
+    report("rng_shuffle()", n, now_ms() - t);
+
+    for (size_t i = 0; i < n; i++)
+        sink += words[i] ^ ints[i];
+    printf("(checksum %llx)\n", (unsigned long long) sink);
+
+    free(ints);
+    free(words);
+    return 0;
+}
@@ -0,0 +1,435 @@
+/* One benchmark for every sort in the tree
+ *
+ * Usage: bench-sort [max elements] [sort name ...]
+ *
+ * Each sort runs on six key distributions at 1e3, 1e4, ... up to the maximum
+ * (default 1e6; 1e8 needs about 4 GiB). For each run it reports the time per
+ * element, comparisons per element for the sorts that take a comparator, and
+ * the peak memory the sort touched beyond its input. Naming sorts on the
+ * command line runs only those.
+ *
+ * The sorts are pulled in from the quiz sources, whose main() functions are
+ * renamed out of the way:
+ *
+ *   qsort              glibc, on an int array, the reference
+ *   sched_sort         quiz9/test.c, parallel bucket sort on an int array
+ *   quick_sort         quiz1/test3.c, first-node pivot
+ *   quick_sort_intro   quiz1/test3.c
+ *   list_quicksort     quiz2/test1.c, recursive, first-node pivot
+ *   list_quicksort3    quiz2/test1.c, iterative, random median-of-three pivot
+ *   list_sort, list_psort, list_asort, list_radix_sort   quiz1/list_*.h
+ *
+ * The quiz2 sorts order uint16_t keys, so they see every key modulo 2^16.
+ * Quadratic sorts are skipped where they would take minutes or overflow the
+ * stack; so are sizes whose memory cannot be allocated.
+ *
+ * List nodes are linked in random memory order, as a list built over time
+ * would be, so that walking the list misses the cache at every step.
+ */
+
+#define _GNU_SOURCE
+
+#include <limits.h>
+#include <malloc.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-function"
+#pragma GCC diagnostic ignored "-Wsign-compare"
+#define main quiz1_main
+#include "../quiz1/test3.c"
+#undef main
+#define main quiz2_main
+#define rng quiz2_rng
+#include "../quiz2/test1.c"
+#undef rng
+#undef main
+#define main quiz9_main
+#include "../quiz9/test.c"
+#undef main
+#pragma GCC diagnostic pop
+
+#include "../quiz1/list_asort.h"
+#include "../quiz1/list_psort.h"
+#include "../quiz1/list_radix.h"
+#include "rng.h"
+
+enum { RANDOM, SORTED, REVERSED, FEW_UNIQUE, ORGAN_PIPE, ZIPF, N_DISTS };
+
+static const char *dist_names[] = {
+    "random", "sorted", "reversed", "few-unique", "organ-pipe", "zipf",
+};
+
+/* Keys for the current size, and the working copies the sorts get */
+static int *keys, *arr;
+static node_t *nodes;
+static struct listitem *items;
+static uint32_t *perm;
+static struct list_head head;
+static size_t n;
+static size_t ncmp;
+
+static void gen_keys(int dist, rng_t *r)
+{
+    switch (dist) {
+    case RANDOM:
+        for (size_t i = 0; i < n; i++)
+            keys[i] = rng_next(r) >> 33;
+        break;
+    case SORTED:
+        for (size_t i = 0; i < n; i++)
+            keys[i] = i;
+        break;
+    case REVERSED:
+        for (size_t i = 0; i < n; i++)
+            keys[i] = n - i;
+        break;
+    case FEW_UNIQUE:
+        for (size_t i = 0; i < n; i++)
+            keys[i] = rng_bounded(r, 4);
+        break;
+    case ORGAN_PIPE:
+        for (size_t i = 0; i < n; i++)
+            keys[i] = i < n / 2 ? i : n - i;
+        break;
+    case ZIPF:
+        /* Rank k with probability ln((k + 1) / k) / ln(n + 1), close to
+         * Zipf with s = 1 over n ranks.
+         */
+        for (size_t i = 0; i < n; i++) {
+            double u = (rng_next(r) >> 11) * 0x1p-53;
+            keys[i] = (int) exp(u * log((double) n + 1));
+        }
+        break;
+    }
+}
+
+static int cmp_qsort(const void *a, const void *b)
+{
+    int x = *(const int *) a, y = *(const int *) b;
+    ncmp++;
+    return (x > y) - (x < y);
+}
+
+static int cmp_node(void *priv,
+                    const struct list_head *a,
+                    const struct list_head *b)
+{
+    long x = list_entry(a, node_t, list)->value;
+    long y = list_entry(b, node_t, list)->value;
+    (void) priv;
+    /* Also called from the list_psort() workers */
+    __atomic_fetch_add(&ncmp, 1, __ATOMIC_RELAXED);
+    return (x > y) - (x < y);
+}
+
+static uint64_t key_node(const struct list_head *node)
+{
+    return (uint64_t) list_entry(node, node_t, list)->value ^ (1ULL << 63);
+}
+
+/* Setup, run and check of one sort; the run is what gets timed. */
+typedef struct {
+    const char *name;
+    void (*prepare)(void);
+    void (*run)(void);
+    bool (*check)(void);
+    bool counts;    /* comparisons are counted */
+    size_t max_n;   /* size limit */
+    size_t max_bad; /* size limit on sorted, repeated or skewed keys */
+} sort_t;
+
+static void prepare_array(void)
+{
+    memcpy(arr, keys, n * sizeof(*arr));
+}
+
+static bool check_array(void)
+{
+    return is_sorted(arr, n);
+}
+
+static void prepare_nodes(void)
+{
+    INIT_LIST_HEAD(&head);
+    for (size_t i = 0; i < n; i++) {
+        node_t *node = &nodes[perm[i]];
+        node->value = keys[i];
+        list_add_tail(&node->list, &head);
+    }
+}
+
+static bool check_nodes(void)
+{
+    struct list_head *node, *prev = &head;
+    long last = LONG_MIN;
+    size_t count = 0;
+
+    list_for_each (node, &head) {
+        long v = list_entry(node, node_t, list)->value;
+        if (v < last || node->prev != prev)
+            return false;
+        last = v;
+        prev = node;
+        count++;
+    }
+    return head.prev == prev && count == n;
+}
+
+static void prepare_items(void)
+{
+    INIT_LIST_HEAD(&head);
+    for (size_t i = 0; i < n; i++) {
+        struct listitem *item = &items[perm[i]];
+        item->i = keys[i];
+        list_add_tail(&item->list, &head);
+    }
+}
+
+static bool check_items(void)
+{
+    struct listitem *item;
+    size_t count = 0;
+    int last = -1;
+
+    list_for_each_entry (item, &head, list) {
+        if (item->i < last)
+            return false;
+        last = item->i;
+        count++;
+    }
+    return count == n;
+}
+
+static void run_qsort(void)
+{
+    qsort(arr, n, sizeof(*arr), cmp_qsort);
+}
+
+static void run_sched_sort(void)
+{
+    sched_sort(arr, n);
+}
+
+static void run_quick_sort(void)
+{
+    quick_sort(&head);
+}
+
+static void run_quick_sort_intro(void)
+{
+    quick_sort_intro(&head);
+}
+
+static void run_list_quicksort(void)
+{
+    list_quicksort(&head);
+}
+
+static void run_list_quicksort3(void)
+{
+    list_quicksort3(&head);
+}
+
+static void run_list_sort(void)
+{
+    list_sort(NULL, &head, cmp_node);
+}
+
+static void run_list_psort(void)
+{
+    list_psort(NULL, &head, cmp_node, sysconf(_SC_NPROCESSORS_ONLN));
+}
+
+static void run_list_asort(void)
+{
+    list_asort(&head, key_node, LIST_ASORT_THRESHOLD);
+}
+
+static void run_list_radix_sort(void)
+{
+    list_radix_sort(&head, key_node, 8);
+}
+
+static const sort_t sorts[] = {
+    {"qsort", prepare_array, run_qsort, check_array, true, SIZE_MAX,
+     SIZE_MAX},
+    {"sched_sort", prepare_array, run_sched_sort, check_array, false,
+     SIZE_MAX, SIZE_MAX},
+    /* Keeps 2n pointers on the stack, and is quadratic on sorted input */
+    {"quick_sort", prepare_nodes, run_quick_sort, check_nodes, false, 100000,
+     10000},
+    {"quick_sort_intro", prepare_nodes, run_quick_sort_intro, check_nodes,
+     false, SIZE_MAX, SIZE_MAX},
+    /* Beyond 2^16 nodes every key repeats. The first takes the first node as
+     * the pivot, so sorted input is quadratic and recurses once per node.
+     * The second picks the median of three random nodes and sets equal keys
+     * aside, so no distribution is worse than random.
+     */
+    {"list_quicksort", prepare_items, run_list_quicksort, check_items, false,
+     100000, 10000},
+    {"list_quicksort3", prepare_items, run_list_quicksort3, check_items,
+     false, SIZE_MAX, SIZE_MAX},
+    {"list_sort", prepare_nodes, run_list_sort, check_nodes, true, SIZE_MAX,
+     SIZE_MAX},
+    {"list_psort", prepare_nodes, run_list_psort, check_nodes, true, SIZE_MAX,
+     SIZE_MAX},
+    {"list_asort", prepare_nodes, run_list_asort, check_nodes, false,
+     SIZE_MAX, SIZE_MAX},
+    {"list_radix_sort", prepare_nodes, run_list_radix_sort, check_nodes,
+     false, SIZE_MAX, SIZE_MAX},
+};
+
+#define N_SORTS (sizeof(sorts) / sizeof(sorts[0]))
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* VmRSS or VmHWM from /proc/self/status, in KiB; -1 if unavailable */
+static long status_kb(const char *field)
+{
+    FILE *f = fopen("/proc/self/status", "r");
+    char line[256];
+    long kb = -1;
+    size_t len = strlen(field);
+
+    if (!f)
+        return -1;
+    while (fgets(line, sizeof(line), f)) {
+        if (!strncmp(line, field, len) && line[len] == ':') {
+            kb = atol(line + len + 1);
+            break;
+        }
+    }
+    fclose(f);
+    return kb;
+}
+
+/* Reset VmHWM to the current RSS; false where the kernel cannot. Memory
+ * freed by earlier runs is handed back first, so that a sort reusing it
+ * still shows up.
+ */
+static bool reset_peak(void)
+{
+    FILE *f;
+    bool ok;
+
+    malloc_trim(0);
+    f = fopen("/proc/self/clear_refs", "w");
+    if (!f)
+        return false;
+    ok = fputs("5", f) >= 0;
+    return !fclose(f) && ok;
+}
+
+static bool selected(const char *name, int argc, char **argv)
+{
+    if (argc <= 2)
+        return true;
+    for (int i = 2; i < argc; i++) {
+        if (!strcmp(argv[i], name))
+            return true;
+    }
+    return false;
+}
+
+int main(int argc, char **argv)
+{
+    size_t max_n = argc > 1 ? strtoul(argv[1], NULL, 0) : 1000000;
+    bool need_nodes = false, need_items = false;
+    rng_t r;
+
+    /* A fixed threshold: large blocks are always unmapped on free. */
+    mallopt(M_MMAP_THRESHOLD, 256 * 1024);
+    for (size_t s = 0; s < N_SORTS; s++) {
+        if (!selected(sorts[s].name, argc, argv))
+            continue;
+        need_nodes |= sorts[s].prepare == prepare_nodes;
+        need_items |= sorts[s].prepare == prepare_items;
+    }
+
+    printf("%-16s %-10s %10s %9s %8s %9s\n", "sort", "keys", "n", "ns/elem",
+           "cmp/n", "peak MiB");
+    for (n = 1000; n <= max_n; n *= 10) {
+        keys = malloc(n * sizeof(*keys));
+        arr = malloc(n * sizeof(*arr));
+        perm = malloc(n * sizeof(*perm));
+        nodes = need_nodes ? malloc(n * sizeof(*nodes)) : NULL;
+        /* The quiz2 items are only needed by two sorts; skip them alone
+         * when they do not fit.
+         */
+        items = need_items ? malloc(n * sizeof(*items)) : NULL;
+        if (!keys || !arr || !perm || (need_nodes && !nodes)) {
+            printf("%zu elements do not fit in memory\n", n);
+            break;
+        }
+        rng_seed(&r, n);
+        for (size_t i = 0; i < n; i++)
+            perm[i] = i;
+        rng_shuffle(&r, perm, n, sizeof(perm[0]));
+
+        for (int d = 0; d < N_DISTS; d++) {
+            gen_keys(d, &r);
+            for (size_t s = 0; s < N_SORTS; s++) {
+                const sort_t *sort = &sorts[s];
+                if (!selected(sort->name, argc, argv) ||
+                    n > sort->max_n ||
+                    (sort->prepare == prepare_items && !items) ||
+                    (d != RANDOM && n > sort->max_bad))
+                    continue;
+
+                /* Repeat small sizes for about 1e6 elements or 0.2 s. */
+                size_t reps = n < 1000000 ? 1000000 / n : 1, k;
+                double ns = 0;
+                long base = 0, peak = -1;
+                bool ok = true;
+                ncmp = 0;
+                for (k = 0; k < reps && ns < 2e8 && ok; k++) {
+                    sort->prepare();
+                    if (!k && reset_peak())
+                        base = status_kb("VmRSS");
+                    double t0 = now_ns();
+                    sort->run();
+                    ns += now_ns() - t0;
+                    if (!k && base > 0)
+                        peak = status_kb("VmHWM") - base;
+                    ok = sort->check();
+                }
+
+                printf("%-16s %-10s %10zu ", sort->name, dist_names[d], n);
+                if (!ok) {
+                    printf("NOT SORTED\n");
+                    continue;
+                }
+                printf("%9.2f ", ns / k / n);
+                if (sort->counts)
+                    printf("%8.2f ", (double) ncmp / k / n);
+                else
+                    printf("%8s ", "-");
+                if (peak >= 0)
+                    printf("%9.1f\n", peak / 1024.0);
+                else
+                    printf("%9s\n", "-");
+                fflush(stdout);
+            }
+        }
+
+        free(items);
+        free(nodes);
+        free(perm);
+        free(arr);
+        free(keys);
+    }
+    return 0;
+}
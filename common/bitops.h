@@ -0,0 +1,132 @@
+/* Leading/trailing zero counts and population counts */
+
+#ifndef BITOPS_H
+#define BITOPS_H
+
+#include <stdint.h>
+
+/*
+ * Every function is defined for 0, where the counts equal the width.
+ *
+ * The implementation is picked at compile time. GCC and Clang get their
+ * builtins, which become a single lzcnt/tzcnt/popcnt where the target has
+ * them (-mlzcnt, -mbmi, -mpopcnt, or -march=native on recent x86), bsr/bsf
+ * plus a select otherwise, and clz/rbit/cnt on Arm; the zero check folds
+ * away when the instruction already handles it. Other compilers, or
+ * -DBITOPS_PORTABLE, get branchless de Bruijn multiplications and SWAR
+ * popcounts, which tests can also call directly as bitops_*_portable().
+ */
+
+/* 0x03f79d71b4cb0a89 << k has a distinct top 6 bits for every k < 64. */
+#define BITOPS_DEBRUIJN64 0x03f79d71b4cb0a89ULL
+
+static const uint8_t bitops_debruijn64_tab[64] = {
+    0,  1,  48, 2,  57, 49, 28, 3,  61, 58, 50, 42, 38, 29, 17, 4,
+    62, 55, 59, 36, 53, 51, 43, 22, 45, 39, 33, 30, 24, 18, 12, 5,
+    63, 47, 56, 27, 60, 41, 37, 16, 54, 35, 52, 21, 44, 32, 23, 11,
+    46, 26, 40, 15, 34, 20, 31, 10, 25, 14, 19, 9,  13, 8,  7,  6,
+};
+
+static inline int bitops_clz64_portable(uint64_t x)
+{
+    /* Smear the top bit down, then isolate it. */
+    x |= x >> 1;
+    x |= x >> 2;
+    x |= x >> 4;
+    x |= x >> 8;
+    x |= x >> 16;
+    x |= x >> 32;
+    x -= x >> 1;
+    return 63 - bitops_debruijn64_tab[(x * BITOPS_DEBRUIJN64) >> 58] +
+           (x == 0);
+}
+
+static inline int bitops_ctz64_portable(uint64_t x)
+{
+    uint64_t low = x & -x;
+    return bitops_debruijn64_tab[(low * BITOPS_DEBRUIJN64) >> 58] +
+           64 * (x == 0);
+}
+
+static inline int bitops_popcount64_portable(uint64_t x)
+{
+    x -= (x >> 1) & 0x5555555555555555ULL;
+    x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+    x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+    return (x * 0x0101010101010101ULL) >> 56;
+}
+
+#if defined(__GNUC__) && !defined(BITOPS_PORTABLE)
+
+static inline int clz64(uint64_t x)
+{
+    return x ? __builtin_clzll(x) : 64;
+}
+
+static inline int clz32(uint32_t x)
+{
+    return x ? __builtin_clz(x) : 32;
+}
+
+static inline int ctz64(uint64_t x)
+{
+    return x ? __builtin_ctzll(x) : 64;
+}
+
+static inline int ctz32(uint32_t x)
+{
+    return x ? __builtin_ctz(x) : 32;
+}
+
+static inline int popcount64(uint64_t x)
+{
+    return __builtin_popcountll(x);
+}
+
+static inline int popcount32(uint32_t x)
+{
+    return __builtin_popcount(x);
+}
+
+#else
+
+static inline int clz64(uint64_t x)
+{
+    return bitops_clz64_portable(x);
+}
+
+static inline int clz32(uint32_t x)
+{
+    return bitops_clz64_portable(x) - 32;
+}
+
+static inline int ctz64(uint64_t x)
+{
+    return bitops_ctz64_portable(x);
+}
+
+static inline int ctz32(uint32_t x)
+{
+    /* Bit 32 stands in for the zero case. */
+    return bitops_ctz64_portable(x | (1ULL << 32));
+}
+
+static inline int popcount64(uint64_t x)
+{
+    return bitops_popcount64_portable(x);
+}
+
+static inline int popcount32(uint32_t x)
+{
+    return bitops_popcount64_portable(x);
+}
+
+#endif
+
+/* Index of the highest set bit; -1 for 0 */
+static inline int ilog2_64(uint64_t x)
+{
+    return 63 - clz64(x);
+}
+
+#endif /* BITOPS_H */
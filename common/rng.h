@@ -0,0 +1,240 @@
+/* Seedable xoshiro256** generator, bounded integers and shuffling */
+
+#ifndef RNG_H
+#define RNG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * xoshiro256** (Blackman and Vigna) has 256 bits of state, a period of
+ * 2^256 - 1 and passes BigCrush; one output costs a handful of shifts, xors
+ * and two multiplies by small constants. The state is seeded from one
+ * 64-bit value through splitmix64, so that nearby seeds give unrelated
+ * streams.
+ *
+ * Bounded integers use Lemire's method: the top half of a 128-bit product
+ * r * range is uniform over [0, range) once the rare draws whose low half
+ * falls below 2^64 mod range are rejected. That remainder, the only
+ * division, is computed only when a draw lands in the rejection zone.
+ *
+ * rng_fill() generates bulk data from 8 independent xoshiro256** lanes
+ * held as vectors, which the compiler maps onto SSE2, AVX2 or AVX-512
+ * registers. Its output is as random as rng_next()'s but not the same
+ * sequence.
+ */
+
+typedef struct {
+    uint64_t s[4];
+} rng_t;
+
+static inline uint64_t _rng_splitmix64(uint64_t *x)
+{
+    uint64_t z = (*x += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/**
+ * Seeds a generator. Equal seeds give equal streams.
+ *
+ * @r : Generator to seed.
+ * @seed : Any value, 0 included.
+ */
+static inline void rng_seed(rng_t *r, uint64_t seed)
+{
+    for (int i = 0; i < 4; i++)
+        r->s[i] = _rng_splitmix64(&seed);
+}
+
+static inline uint64_t _rng_rotl(uint64_t x, int k)
+{
+    return (x << k) | (x >> (64 - k));
+}
+
+/**
+ * Returns 64 uniformly random bits.
+ */
+static inline uint64_t rng_next(rng_t *r)
+{
+    uint64_t *s = r->s;
+    uint64_t result = _rng_rotl(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = _rng_rotl(s[3], 45);
+    return result;
+}
+
+/**
+ * Returns a uniformly random integer in [0, @range). @range must not be 0.
+ */
+static inline uint64_t rng_bounded(rng_t *r, uint64_t range)
+{
+    __uint128_t m = (__uint128_t) rng_next(r) * range;
+    uint64_t low = (uint64_t) m;
+
+    if (low < range) {
+        uint64_t threshold = -range % range;
+        while (low < threshold) {
+            m = (__uint128_t) rng_next(r) * range;
+            low = (uint64_t) m;
+        }
+    }
+    return m >> 64;
+}
+
+/* Swap two elements of @size bytes; the common sizes avoid memcpy calls. */
+static inline void _rng_swap(char *a, char *b, size_t size)
+{
+    switch (size) {
+#define _RNG_SWAP(type)                         \
+    case sizeof(type): {                        \
+        type t;                                 \
+        memcpy(&t, a, sizeof(type));            \
+        memcpy(a, b, sizeof(type));             \
+        memcpy(b, &t, sizeof(type));            \
+        return;                                 \
+    }
+        _RNG_SWAP(uint8_t)
+        _RNG_SWAP(uint16_t)
+        _RNG_SWAP(uint32_t)
+        _RNG_SWAP(uint64_t)
+#undef _RNG_SWAP
+    }
+    while (size--) {
+        char t = *a;
+        *a++ = *b;
+        *b++ = t;
+    }
+}
+
+/**
+ * Shuffles an array in place with Fisher-Yates. Every permutation is
+ * equally likely, for any length.
+ *
+ * @r : Generator.
+ * @base : First element.
+ * @nmemb : Number of elements.
+ * @size : Size of one element, as for qsort().
+ */
+static inline void rng_shuffle(rng_t *r, void *base, size_t nmemb, size_t size)
+{
+    char *a = base;
+
+    for (size_t i = nmemb; i > 1; i--) {
+        size_t j = rng_bounded(r, i);
+        if (j != i - 1)
+            _rng_swap(a + j * size, a + (i - 1) * size, size);
+    }
+}
+
+#define RNG_LANES 8
+
+typedef uint64_t _rng_vec_t __attribute__((vector_size(RNG_LANES * 8)));
+
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(__clang__)
+#define _RNG_TARGETS __attribute__((target_clones("avx512f", "avx2", "default")))
+#else
+#define _RNG_TARGETS
+#endif
+
+/* The vector loop proper; returns how many words it wrote. */
+_RNG_TARGETS static size_t _rng_fill_lanes(uint64_t *out,
+                                           size_t n,
+                                           uint64_t state[4][RNG_LANES])
+{
+    _rng_vec_t s0, s1, s2, s3;
+    size_t i = 0;
+
+    memcpy(&s0, state[0], sizeof(s0));
+    memcpy(&s1, state[1], sizeof(s1));
+    memcpy(&s2, state[2], sizeof(s2));
+    memcpy(&s3, state[3], sizeof(s3));
+    for (; i + RNG_LANES <= n; i += RNG_LANES) {
+        /* rotl(s1 * 5, 7) * 9, with the multiplies as shifts and adds */
+        _rng_vec_t x = s1 + (s1 << 2);
+        x = (x << 7) | (x >> 57);
+        x = x + (x << 3);
+        memcpy(out + i, &x, sizeof(x));
+
+        _rng_vec_t t = s1 << 17;
+        s2 ^= s0;
+        s3 ^= s1;
+        s1 ^= s2;
+        s0 ^= s3;
+        s2 ^= t;
+        s3 = (s3 << 45) | (s3 >> 19);
+    }
+    memcpy(state[0], &s0, sizeof(s0));
+    memcpy(state[1], &s1, sizeof(s1));
+    memcpy(state[2], &s2, sizeof(s2));
+    memcpy(state[3], &s3, sizeof(s3));
+    return i;
+}
+
+/**
+ * Fills an array with uniformly random 64-bit words, several times faster
+ * than calling rng_next() in a loop for large @n.
+ *
+ * @r : Generator; it seeds the lanes and produces the last few words.
+ * @out : Destination.
+ * @n : Number of words.
+ */
+static inline void rng_fill(rng_t *r, uint64_t *out, size_t n)
+{
+    size_t i = 0;
+
+    if (n >= 4 * RNG_LANES) {
+        uint64_t state[4][RNG_LANES], seed = rng_next(r);
+        for (int k = 0; k < 4; k++) {
+            for (int l = 0; l < RNG_LANES; l++)
+                state[k][l] = _rng_splitmix64(&seed);
+        }
+        i = _rng_fill_lanes(out, n, state);
+    }
+    for (; i < n; i++)
+        out[i] = rng_next(r);
+}
+
+/**
+ * Fills an array with uniformly random integers in [0, @range).
+ *
+ * @r : Generator.
+ * @out : Destination.
+ * @n : Number of integers.
+ * @range : Exclusive upper bound, at least 1.
+ */
+static inline void rng_fill_bounded(rng_t *r,
+                                    uint32_t *out,
+                                    size_t n,
+                                    uint32_t range)
+{
+    uint32_t threshold = -range % range;
+    uint64_t buf[1024];
+
+    /* Each 64-bit word yields two 32-bit draws for Lemire's reduction. */
+    for (size_t i = 0; i < n;) {
+        size_t words = (n - i + 1) / 2;
+        if (words > 1024)
+            words = 1024;
+        rng_fill(r, buf, words);
+        for (size_t w = 0; w < words && i < n; w++) {
+            for (int half = 0; half < 2 && i < n; half++) {
+                uint64_t m = (uint64_t) (uint32_t) (buf[w] >> (32 * half)) *
+                             range;
+                while ((uint32_t) m < threshold)
+                    m = (rng_next(r) >> 32) * range;
+                out[i++] = m >> 32;
+            }
+        }
+    }
+}
+
+#endif /* RNG_H */
@@ -0,0 +1,120 @@
+#include <stdint.h>
+#include <stdio.h>
+
+#include "bitops.h"
+#include "rng.h"
+
+#define my_assert(test, message) \
+    do {                         \
+        if (!(test))             \
+            return message;      \
+    } while (0)
+#define my_run_test(test)       \
+    do {                        \
+        char *message = test(); \
+        tests_run++;            \
+        if (message)            \
+            return message;     \
+    } while (0)
+
+static int naive_clz64(uint64_t x)
+{
+    int n = 0;
+    for (uint64_t m = 1ULL << 63; m && !(x & m); m >>= 1)
+        n++;
+    return n;
+}
+
+static int naive_ctz64(uint64_t x)
+{
+    int n = 0;
+    for (uint64_t m = 1; m && !(x & m); m <<= 1)
+        n++;
+    return n;
+}
+
+static int naive_popcount64(uint64_t x)
+{
+    int n = 0;
+    for (; x; x &= x - 1)
+        n++;
+    return n;
+}
+
+/* Check every variant against the naive loops on one value. */
+static char *check(uint64_t x)
+{
+    uint32_t lo = x;
+
+    my_assert(clz64(x) == naive_clz64(x), "clz64 is wrong");
+    my_assert(bitops_clz64_portable(x) == naive_clz64(x),
+              "Portable clz64 is wrong");
+    my_assert(clz32(lo) == naive_clz64(lo) - 32, "clz32 is wrong");
+
+    my_assert(ctz64(x) == naive_ctz64(x), "ctz64 is wrong");
+    my_assert(bitops_ctz64_portable(x) == naive_ctz64(x),
+              "Portable ctz64 is wrong");
+    my_assert(ctz32(lo) == (lo ? naive_ctz64(lo) : 32), "ctz32 is wrong");
+
+    my_assert(popcount64(x) == naive_popcount64(x), "popcount64 is wrong");
+    my_assert(bitops_popcount64_portable(x) == naive_popcount64(x),
+              "Portable popcount64 is wrong");
+    my_assert(popcount32(lo) == naive_popcount64(lo), "popcount32 is wrong");
+    return NULL;
+}
+
+static char *test_edges(void)
+{
+    char *msg;
+
+    my_assert(clz64(0) == 64 && ctz64(0) == 64, "Zero should count 64");
+    my_assert(clz32(0) == 32 && ctz32(0) == 32, "Zero should count 32");
+    my_assert(ilog2_64(0) == -1 && ilog2_64(1) == 0 && ilog2_64(~0ULL) == 63,
+              "ilog2_64 is wrong");
+
+    /* Every single bit, every low mask and every high mask */
+    for (int k = 0; k < 64; k++) {
+        uint64_t bit = 1ULL << k;
+        if ((msg = check(bit)) || (msg = check(bit - 1)) ||
+            (msg = check(~(bit - 1))) || (msg = check(bit | 1)))
+            return msg;
+    }
+    return check(~0ULL);
+}
+
+static char *test_random(void)
+{
+    rng_t r;
+    char *msg;
+
+    rng_seed(&r, 43);
+    for (int i = 0; i < 1000000; i++) {
+        uint64_t x = rng_next(&r);
+        /* Vary the width, so that every clz is hit often. */
+        x >>= rng_bounded(&r, 64);
+        if ((msg = check(x)))
+            return msg;
+    }
+    return NULL;
+}
+
+int tests_run = 0;
+
+static char *test_suite(void)
+{
+    my_run_test(test_edges);
+    my_run_test(test_random);
+    return NULL;
+}
+
+int main(void)
+{
+    printf("---=[ Bit operation tests\n");
+    char *result = test_suite();
+    if (result)
+        printf("ERROR: %s\n", result);
+    else
+        printf("ALL TESTS PASSED\n");
+    printf("Tests run: %d\n", tests_run);
+    return !!result;
+}
@@ -0,0 +1,189 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rng.h"
+
+#define my_assert(test, message) \
+    do {                         \
+        if (!(test))             \
+            return message;      \
+    } while (0)
+#define my_run_test(test)       \
+    do {                        \
+        char *message = test(); \
+        tests_run++;            \
+        if (message)            \
+            return message;     \
+    } while (0)
+
+/* Pearson's statistic of @count against a uniform expectation */
+static double chi2(const size_t *count, int bins, size_t draws)
+{
+    double expect = (double) draws / bins, sum = 0;
+    for (int i = 0; i < bins; i++)
+        sum += (count[i] - expect) * (count[i] - expect) / expect;
+    return sum;
+}
+
+static char *test_reference(void)
+{
+    /* First outputs of the reference implementation from this state */
+    const uint64_t expect[] = {11520, 0, 1509978240, 1215971899390074240ULL};
+    rng_t r = {{1, 2, 3, 4}};
+
+    for (int i = 0; i < 4; i++)
+        my_assert(rng_next(&r) == expect[i], "Output differs from xoshiro256**");
+
+    rng_t a, b;
+    rng_seed(&a, 0);
+    rng_seed(&b, 0);
+    for (int i = 0; i < 1000; i++)
+        my_assert(rng_next(&a) == rng_next(&b), "Equal seeds should repeat");
+    rng_seed(&b, 1);
+    my_assert(rng_next(&a) != rng_next(&b), "Seeds 0 and 1 should differ");
+    return NULL;
+}
+
+static char *test_bounded(void)
+{
+    size_t count[7] = {0};
+    rng_t r;
+
+    rng_seed(&r, 42);
+    for (int i = 0; i < 700000; i++)
+        count[rng_bounded(&r, 7)]++;
+    /* 6 degrees of freedom; 22.46 is the 0.1% critical value */
+    my_assert(chi2(count, 7, 700000) < 22.46, "Bounded draws are not uniform");
+
+    for (int i = 0; i < 1000; i++)
+        my_assert(rng_bounded(&r, 1) == 0, "Range 1 allows only 0");
+
+    /* Just above 2^63, nearly half the raw draws are rejected. */
+    uint64_t range = (1ULL << 63) + 1;
+    size_t high = 0;
+    for (int i = 0; i < 100000; i++) {
+        uint64_t v = rng_bounded(&r, range);
+        my_assert(v < range, "Bounded draw out of range");
+        high += v >= range / 2;
+    }
+    my_assert(high > 49000 && high < 51000, "Large range is skewed");
+    return NULL;
+}
+
+static char *test_shuffle(void)
+{
+    size_t count[24] = {0};
+    rng_t r;
+
+    rng_seed(&r, 7);
+    for (int i = 0; i < 240000; i++) {
+        int a[4] = {0, 1, 2, 3}, code = 0;
+        rng_shuffle(&r, a, 4, sizeof(a[0]));
+        /* Lehmer code of the permutation */
+        for (int k = 0; k < 4; k++) {
+            int smaller = 0;
+            for (int m = k + 1; m < 4; m++)
+                smaller += a[m] < a[k];
+            code = code * (4 - k) + smaller;
+        }
+        count[code]++;
+    }
+    /* 23 degrees of freedom; 49.73 is the 0.1% critical value */
+    my_assert(chi2(count, 24, 240000) < 49.73,
+              "Permutations are not equally likely");
+
+    /* Odd element sizes and edge lengths keep every element. */
+    struct {
+        char tag[12];
+    } e[1000];
+    for (size_t n = 0; n <= 1000; n = n ? n * 10 : 1) {
+        int seen[1000] = {0};
+        for (size_t i = 0; i < n; i++)
+            snprintf(e[i].tag, sizeof(e[i].tag), "%zu", i);
+        rng_shuffle(&r, e, n, sizeof(e[0]));
+        for (size_t i = 0; i < n; i++)
+            seen[atoi(e[i].tag)]++;
+        for (size_t i = 0; i < n; i++)
+            my_assert(seen[i] == 1, "Shuffle lost or duplicated an element");
+    }
+    return NULL;
+}
+
+static char *test_fill(void)
+{
+    static uint64_t buf[100003];
+    size_t ones[64] = {0};
+    rng_t r;
+
+    rng_seed(&r, 3);
+    for (size_t n = 0; n < 100; n++) {
+        memset(buf, 0, sizeof(buf));
+        rng_fill(&r, buf, n);
+        my_assert(!buf[n], "Fill wrote past the end");
+        for (size_t i = 0; i < n; i++)
+            my_assert(buf[i], "Fill left a word unset");
+    }
+
+    rng_fill(&r, buf, 100003);
+    for (size_t i = 0; i < 100003; i++) {
+        for (int b = 0; b < 64; b++)
+            ones[b] += buf[i] >> b & 1;
+        /* Adjacent words come from different lanes. */
+        if (i)
+            my_assert(buf[i] != buf[i - 1], "Lanes repeat each other");
+    }
+    for (int b = 0; b < 64; b++)
+        my_assert(ones[b] > 49000 && ones[b] < 51000, "Biased bit in fill");
+    return NULL;
+}
+
+static char *test_fill_bounded(void)
+{
+    static uint32_t buf[100001];
+    size_t count[10] = {0};
+    rng_t r;
+
+    rng_seed(&r, 5);
+    rng_fill_bounded(&r, buf, 100001, 1);
+    for (size_t i = 0; i < 100001; i++)
+        my_assert(!buf[i], "Range 1 allows only 0");
+
+    rng_fill_bounded(&r, buf, 100000, 10);
+    for (size_t i = 0; i < 100000; i++) {
+        my_assert(buf[i] < 10, "Bounded fill out of range");
+        count[buf[i]]++;
+    }
+    /* 9 degrees of freedom; 27.88 is the 0.1% critical value */
+    my_assert(chi2(count, 10, 100000) < 27.88, "Bounded fill is not uniform");
+
+    rng_fill_bounded(&r, buf, 100000, UINT32_MAX);
+    for (size_t i = 0; i < 100000; i++)
+        my_assert(buf[i] < UINT32_MAX, "Bounded fill out of range");
+    return NULL;
+}
+
+int tests_run = 0;
+
+static char *test_suite(void)
+{
+    my_run_test(test_reference);
+    my_run_test(test_bounded);
+    my_run_test(test_shuffle);
+    my_run_test(test_fill);
+    my_run_test(test_fill_bounded);
+    return NULL;
+}
+
+int main(void)
+{
+    printf("---=[ RNG tests\n");
+    char *result = test_suite();
+    if (result)
+        printf("ERROR: %s\n", result);
+    else
+        printf("ALL TESTS PASSED\n");
+    printf("Tests run: %d\n", tests_run);
+    return !!result;
+}
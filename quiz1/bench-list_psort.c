@@ -0,0 +1,120 @@
+/* Scaling of list_psort() over thread count and list length
+ *
+ * Usage: bench-list_psort [max nodes] [max threads]
+ *
+ * Nodes live in one array but are linked in random order, so that every
+ * step along the list is a cache miss, as for a list built over time. For
+ * each length from 1e5 up to the maximum (default 1e7), the same list is
+ * sorted with 1, 2, 4, ... threads; one thread is plain list_sort().
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "list_psort.h"
+
+typedef struct {
+    long value;
+    struct list_head list;
+} node_t;
+
+static int cmp_value(void *priv,
+                     const struct list_head *a,
+                     const struct list_head *b)
+{
+    long va = list_entry(a, node_t, list)->value;
+    long vb = list_entry(b, node_t, list)->value;
+    (void) priv;
+    return (va > vb) - (va < vb);
+}
+
+static uint64_t rng = 0x9E3779B97F4A7C15ULL;
+
+static inline uint64_t xorshift64(void)
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return rng;
+}
+
+/* Link @nodes into @head in the order given by @perm. */
+static void build(struct list_head *head,
+                  node_t *nodes,
+                  const uint32_t *perm,
+                  size_t n)
+{
+    INIT_LIST_HEAD(head);
+    for (size_t i = 0; i < n; i++)
+        list_add_tail(&nodes[perm[i]].list, head);
+}
+
+static int is_sorted(struct list_head *head, size_t n)
+{
+    struct list_head *node;
+    long last = -1;
+    size_t count = 0;
+
+    list_for_each (node, head) {
+        long v = list_entry(node, node_t, list)->value;
+        if (v < last || node->next->prev != node)
+            return 0;
+        last = v;
+        count++;
+    }
+    return count == n;
+}
+
+int main(int argc, char **argv)
+{
+    size_t max_n = argc > 1 ? strtoul(argv[1], NULL, 0) : 10000000;
+    int max_threads = argc > 2 ? atoi(argv[2]) : 8;
+    node_t *nodes = malloc(max_n * sizeof(node_t));
+    uint32_t *perm = malloc(max_n * sizeof(uint32_t));
+    struct list_head head;
+
+    if (!nodes || !perm)
+        return 1;
+
+    printf("%10s %8s %10s %8s\n", "nodes", "threads", "ms", "speedup");
+    for (size_t n = 100000; n <= max_n; n *= 10) {
+        double base = 0;
+
+        for (size_t i = 0; i < n; i++) {
+            nodes[i].value = xorshift64() % n;
+            perm[i] = i;
+        }
+        for (size_t i = n - 1; i > 0; i--) {
+            size_t j = xorshift64() % (i + 1);
+            uint32_t t = perm[i];
+            perm[i] = perm[j];
+            perm[j] = t;
+        }
+
+        for (int t = 1; t <= max_threads; t *= 2) {
+            struct timespec t0, t1;
+
+            build(&head, nodes, perm, n);
+            clock_gettime(CLOCK_MONOTONIC, &t0);
+            list_psort(NULL, &head, cmp_value, t);
+            clock_gettime(CLOCK_MONOTONIC, &t1);
+            if (!is_sorted(&head, n)) {
+                printf("ERROR: list not sorted (%zu nodes, %d threads)\n", n,
+                       t);
+                return 1;
+            }
+
+            double ms = (t1.tv_sec - t0.tv_sec) * 1e3 +
+                        (t1.tv_nsec - t0.tv_nsec) * 1e-6;
+            if (t == 1)
+                base = ms;
+            printf("%10zu %8d %10.1f %7.2fx\n", n, t, ms, base / ms);
+        }
+    }
+
+    free(perm);
+    free(nodes);
+    return 0;
+}
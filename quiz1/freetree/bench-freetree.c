@@ -0,0 +1,312 @@
+/* Fragmentation-heavy malloc/free benchmark: free-tree allocator vs. glibc
+ *
+ * Usage: bench-freetree [operations]
+ *
+ * The synthetic trace alternates growth phases with random mass frees, so
+ * that long-lived objects pin holes of every size between them, and then
+ * refills the holes with objects drawn from a different size mix.
+ *
+ * A second run churns through objects below 256 bytes from several threads,
+ * which is what the size-class front end serves without touching the tree.
+ *
+ * A spike run models a load spike: it allocates a few hundred MiB, frees all
+ * of it but a sparse set of survivors, and reports how much of the spike's
+ * resident memory is given back. A heap still holding free memory from
+ * earlier runs would serve the spike from it, so each allocator's spike runs
+ * first, in a child forked before anything is allocated, and both start from
+ * the same empty heap.
+ */
+
+#include <assert.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "freetree.h"
+
+#define NSLOTS 100000
+
+#define SMALL_SLOTS 1024
+#define SMALL_OPS 4000000
+#define MAX_THREADS 4
+
+#define SPIKE_OBJS 200000
+#define SPIKE_KEEP 256 /* one survivor every SPIKE_KEEP objects */
+
+typedef struct {
+    uint32_t slot;
+    uint32_t size; /* 0 means free */
+} op_t;
+
+typedef struct {
+    const char *name;
+    void *(*malloc)(size_t);
+    void (*free)(void *);
+    size_t (*footprint)(void);
+} allocator_t;
+
+static size_t ft_footprint(void)
+{
+    ft_stats_t st;
+    ft_get_stats(&st);
+    return st.heap_bytes;
+}
+
+static size_t glibc_footprint(void)
+{
+    struct mallinfo2 mi = mallinfo2();
+    return mi.arena + mi.hblkhd;
+}
+
+static uint64_t rng = 88172645463325252ULL;
+
+static inline uint64_t xorshift64(void)
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return rng;
+}
+
+/* 70% small, 25% medium, 5% large; @phase shifts the mix between refills. */
+static uint32_t draw_size(int phase)
+{
+    uint64_t r = xorshift64();
+    unsigned pct = r % 100;
+    r >>= 8;
+    if (pct < 70)
+        return 16 + r % (phase & 1 ? 240 : 112);
+    if (pct < 95)
+        return 256 + r % (phase & 1 ? 1792 : 3840);
+    return 4096 + r % 61440;
+}
+
+static op_t *make_trace(size_t nops, size_t *out_n)
+{
+    op_t *ops = malloc(sizeof(op_t) * nops);
+    uint32_t *live = calloc(NSLOTS, sizeof(uint32_t));
+    size_t n = 0;
+    int phase = 0;
+
+    assert(ops && live);
+    while (n < nops) {
+        /* Grow: fill every empty slot. */
+        for (uint32_t s = 0; s < NSLOTS && n < nops; s++) {
+            if (!live[s]) {
+                live[s] = draw_size(phase);
+                ops[n++] = (op_t){s, live[s]};
+            }
+        }
+        /* Punch holes: free about 3 in 4 objects at random. */
+        for (uint32_t s = 0; s < NSLOTS && n < nops; s++) {
+            if (live[s] && xorshift64() % 4) {
+                live[s] = 0;
+                ops[n++] = (op_t){s, 0};
+            }
+        }
+        phase++;
+    }
+    free(live);
+    *out_n = n;
+    return ops;
+}
+
+static void run(const allocator_t *a, const op_t *ops, size_t n)
+{
+    void **slots = calloc(NSLOTS, sizeof(void *));
+    size_t *sizes = calloc(NSLOTS, sizeof(size_t));
+    size_t live = 0, peak_live = 0, peak_heap = 0;
+    struct timespec t0, t1;
+
+    assert(slots && sizes);
+    /* Do not charge the driver's own buffers to the allocator. */
+    size_t base = a->footprint();
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (size_t i = 0; i < n; i++) {
+        uint32_t s = ops[i].slot;
+        if (ops[i].size) {
+            slots[s] = a->malloc(ops[i].size);
+            memset(slots[s], s & 0xff, ops[i].size < 64 ? ops[i].size : 64);
+            ((unsigned char *) slots[s])[ops[i].size - 1] = s & 0xff;
+            sizes[s] = ops[i].size;
+            live += sizes[s];
+            if (live > peak_live)
+                peak_live = live;
+        } else {
+            /* Catch overlapping blocks. */
+            assert(*(unsigned char *) slots[s] == (s & 0xff));
+            assert(((unsigned char *) slots[s])[sizes[s] - 1] == (s & 0xff));
+            a->free(slots[s]);
+            live -= sizes[s];
+            sizes[s] = 0;
+        }
+        if ((i & 4095) == 0) {
+            size_t fp = a->footprint() - base;
+            if (fp > peak_heap)
+                peak_heap = fp;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    size_t fp = a->footprint() - base;
+    if (fp > peak_heap)
+        peak_heap = fp;
+    double sec = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9;
+    printf("%-9s %7.1f ns/op  peak heap %8.1f MiB  peak live %8.1f MiB  "
+           "overhead %5.1f%%\n",
+           a->name, sec * 1e9 / n, peak_heap / 1048576.0,
+           peak_live / 1048576.0, 100.0 * (peak_heap - peak_live) / peak_heap);
+
+    for (uint32_t s = 0; s < NSLOTS; s++) {
+        if (sizes[s])
+            a->free(slots[s]);
+    }
+    free(sizes);
+    free(slots);
+}
+
+typedef struct {
+    const allocator_t *a;
+    uint64_t seed;
+} small_ctx_t;
+
+static void *small_worker(void *arg)
+{
+    small_ctx_t *ctx = arg;
+    void *slots[SMALL_SLOTS] = {0};
+    uint64_t x = ctx->seed;
+
+    for (size_t i = 0; i < SMALL_OPS; i++) {
+        x ^= x << 13, x ^= x >> 7, x ^= x << 17;
+        size_t s = x % SMALL_SLOTS;
+        if (slots[s]) {
+            ctx->a->free(slots[s]);
+            slots[s] = NULL;
+        } else {
+            slots[s] = ctx->a->malloc(8 + (x >> 32) % 249);
+            *(char *) slots[s] = 1;
+        }
+    }
+    for (size_t s = 0; s < SMALL_SLOTS; s++)
+        ctx->a->free(slots[s]);
+    return NULL;
+}
+
+static void run_small(const allocator_t *a, int nthreads)
+{
+    pthread_t tids[MAX_THREADS];
+    small_ctx_t ctx[MAX_THREADS];
+    struct timespec t0, t1;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (int i = 0; i < nthreads; i++) {
+        ctx[i] = (small_ctx_t){a, 0x9E3779B97F4A7C15ULL * (i + 1)};
+        pthread_create(&tids[i], NULL, small_worker, &ctx[i]);
+    }
+    for (int i = 0; i < nthreads; i++)
+        pthread_join(tids[i], NULL);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    double sec = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9;
+    printf("%-9s small objects, %d thread(s): %6.1f ns/op\n", a->name,
+           nthreads, sec * 1e9 / ((double) SMALL_OPS * nthreads));
+}
+
+/* Resident set size in KiB */
+static long rss_kb(void)
+{
+    FILE *f = fopen("/proc/self/status", "r");
+    char line[128];
+    long kb = -1;
+
+    if (!f)
+        return -1;
+    while (fgets(line, sizeof(line), f)) {
+        if (!strncmp(line, "VmRSS:", 6)) {
+            kb = strtol(line + 6, NULL, 10);
+            break;
+        }
+    }
+    fclose(f);
+    return kb;
+}
+
+static void run_spike(const allocator_t *a)
+{
+    void **objs = malloc(SPIKE_OBJS * sizeof(void *));
+    uint64_t x = 0x2545F4914F6CDD1DULL;
+
+    assert(objs);
+    long before = rss_kb();
+    for (size_t i = 0; i < SPIKE_OBJS; i++) {
+        x ^= x << 13, x ^= x >> 7, x ^= x << 17;
+        size_t size = 64 + x % 2048;
+        objs[i] = a->malloc(size);
+        memset(objs[i], 0xa5, size);
+    }
+    long peak = rss_kb();
+    for (size_t i = 0; i < SPIKE_OBJS; i++) {
+        if (i % SPIKE_KEEP)
+            a->free(objs[i]);
+    }
+    long after = rss_kb();
+
+    printf("%-9s spike: RSS %6.1f MiB -> %6.1f MiB at peak -> %6.1f MiB "
+           "(%.1f%% of the spike kept)\n",
+           a->name, before / 1024.0, peak / 1024.0, after / 1024.0,
+           100.0 * (after - before) / (peak - before));
+
+    for (size_t i = 0; i < SPIKE_OBJS; i += SPIKE_KEEP)
+        a->free(objs[i]);
+    free(objs);
+}
+
+/* Run the spike in a child forked before this process allocated anything */
+static void run_spike_fresh(const allocator_t *a)
+{
+    pid_t pid;
+
+    fflush(stdout);
+    pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        return;
+    }
+    if (!pid) {
+        run_spike(a);
+        fflush(stdout);
+        _exit(0);
+    }
+    waitpid(pid, NULL, 0);
+}
+
+int main(int argc, char **argv)
+{
+    size_t nops = argc > 1 ? strtoul(argv[1], NULL, 0) : 2000000, n;
+    const allocator_t allocators[] = {
+        {"freetree", ft_malloc, ft_free, ft_footprint},
+        {"glibc", malloc, free, glibc_footprint},
+    };
+
+    size_t nalloc = sizeof(allocators) / sizeof(allocators[0]);
+
+    for (size_t i = 0; i < nalloc; i++)
+        run_spike_fresh(&allocators[i]);
+
+    op_t *ops = make_trace(nops, &n);
+    for (size_t i = 0; i < nalloc; i++)
+        run(&allocators[i], ops, n);
+    free(ops);
+
+    for (int t = 1; t <= MAX_THREADS; t *= 2) {
+        for (size_t i = 0; i < nalloc; i++)
+            run_small(&allocators[i], t);
+    }
+    return 0;
+}
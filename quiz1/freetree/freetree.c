@@ -0,0 +1,593 @@
+#include <assert.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "freetree.h"
+
+/* Block layout
+ *
+ *   allocated: [size|flags][payload ...............]
+ *   free:      [size|flags][l][r] ........... [size]
+ *
+ * Free blocks repeat their size in a footer so that the following block can
+ * find its predecessor when it is freed. Allocated blocks need no footer: the
+ * PREV_ALLOC bit of their successor tells that there is nothing to merge.
+ *
+ * Memory comes from the system in arenas (see below). The first block of an
+ * arena has PREV_ALLOC set and the arena ends with a zero-sized allocated
+ * header, so coalescing never runs off either end.
+ */
+#define ALLOC 1UL      /* this block is in use */
+#define PREV_ALLOC 2UL /* the block before this one is in use */
+#define FIRST 4UL      /* this block starts its arena */
+#define TRIMMED 8UL    /* free block whose interior pages were given back */
+#define FLAGS (ALLOC | PREV_ALLOC | FIRST | TRIMMED)
+
+#define HDR sizeof(size_t)
+#define MIN_BLOCK (sizeof(block_t) + HDR) /* header, tree links, footer */
+
+#define ALIGN_UP(x, a) (((x) + (a) -1) & ~((a) -1))
+
+#define bsize(b) ((b)->size & ~FLAGS)
+
+/* A block's owner reads its size without the heap lock while the PREV_ALLOC
+ * bit of the same word may be flipped, under the lock, on behalf of the block
+ * before it. Both sides therefore access the word atomically.
+ */
+#define bsize_unlocked(b) \
+    (__atomic_load_n(&(b)->size, __ATOMIC_RELAXED) & ~FLAGS)
+#define set_prev_alloc(b) \
+    __atomic_fetch_or(&(b)->size, PREV_ALLOC, __ATOMIC_RELAXED)
+#define clear_prev_alloc(b) \
+    __atomic_fetch_and(&(b)->size, ~PREV_ALLOC, __ATOMIC_RELAXED)
+#define next_block(b) ((block_t *) ((char *) (b) + bsize(b)))
+#define footer(b) ((size_t *) ((char *) (b) + bsize(b)) - 1)
+#define payload(b) ((void *) &(b)->l)
+#define from_payload(p) ((block_t *) ((char *) (p) -HDR))
+
+static block_t *root;
+static ft_stats_t stats;
+
+/* Arenas
+ *
+ *   [arena_t][first block ... ][end header]
+ *
+ * The heap grows by mmap()ing arenas of at least ARENA_SIZE bytes, all kept
+ * on a list. When a free leaves the FIRST block of an arena reaching up to
+ * its end header, the whole arena is free and is unmapped, except for the
+ * last one, which is kept to absorb the next spike.
+ *
+ * Within arenas, free blocks of at least TRIM_THRESHOLD bytes hand their
+ * whole interior pages back with MADV_DONTNEED. The header, tree links and
+ * footer stay outside the released range, since those pages read back as
+ * zeros. The TRIMMED bit records that this was done, so that freeing a small
+ * neighbor only releases the pages it dirtied and not the whole block again.
+ */
+#define ARENA_SIZE (4UL << 20)
+#define TRIM_THRESHOLD (64UL << 10)
+
+typedef struct arena {
+    struct arena *prev, *next;
+    size_t len;
+} arena_t;
+
+/* Offset of the first header, so that payloads are FT_ALIGN'ed */
+#define ARENA_HDR (ALIGN_UP(sizeof(arena_t) + HDR, FT_ALIGN) - HDR)
+
+static arena_t *arenas;
+static size_t narenas, page_size;
+
+/* The free tree is a treap ordered by (size, address). Priorities are not
+ * stored: they are a hash of the block address, which is as random as a
+ * stored priority and keeps the node within the 32-byte minimum block. The
+ * expected depth is O(log n) whatever the allocation pattern, and every
+ * operation below is a single top-down pass over link pointers.
+ */
+static inline uintptr_t prio(const block_t *b)
+{
+    uintptr_t x = (uintptr_t) b;
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    return x;
+}
+
+static inline int less(const block_t *a, const block_t *b)
+{
+    size_t sa = bsize(a), sb = bsize(b);
+    return sa < sb || (sa == sb && a < b);
+}
+
+/* Join two treaps where every block of @a orders before every block of @b. */
+static block_t *merge_free_tree(block_t *a, block_t *b)
+{
+    block_t *res, **link = &res;
+
+    while (a && b) {
+        if (prio(a) > prio(b)) {
+            *link = a;
+            link = &a->r;
+            a = a->r;
+        } else {
+            *link = b;
+            link = &b->l;
+            b = b->l;
+        }
+    }
+    *link = a ? a : b;
+    return res;
+}
+
+static void insert_free_tree(block_t **root, block_t *node)
+{
+    block_t **link = root;
+
+    /* Descend while the existing nodes outrank the new one ... */
+    while (*link && prio(*link) > prio(node))
+        link = less(node, *link) ? &(*link)->l : &(*link)->r;
+
+    /* ... then split the rest of the subtree around it. */
+    block_t *t = *link, **lt = &node->l, **gt = &node->r;
+    while (t) {
+        if (less(t, node)) {
+            *lt = t;
+            lt = &t->r;
+            t = t->r;
+        } else {
+            *gt = t;
+            gt = &t->l;
+            t = t->l;
+        }
+    }
+    *lt = *gt = NULL;
+    *link = node;
+
+    stats.free_blocks++;
+    stats.free_bytes += bsize(node);
+}
+
+static void remove_free_tree(block_t **root, block_t *target)
+{
+    block_t **link = root;
+
+    while (*link != target) {
+        assert(*link);
+        link = less(target, *link) ? &(*link)->l : &(*link)->r;
+    }
+    *link = merge_free_tree(target->l, target->r);
+    target->l = target->r = NULL;
+
+    stats.free_blocks--;
+    stats.free_bytes -= bsize(target);
+}
+
+block_t **find_free_tree(block_t **root, size_t size)
+{
+    block_t **link = root, **best = NULL;
+    size_t depth = 0;
+
+    while (*link) {
+        if (bsize(*link) >= size) {
+            best = link;
+            link = &(*link)->l;
+        } else {
+            link = &(*link)->r;
+        }
+        depth++;
+    }
+    stats.depth_hist[depth < FT_DEPTH_HIST ? depth : FT_DEPTH_HIST - 1]++;
+    return best;
+}
+
+/* Turn @b into a free block of @size bytes and put it into the tree. The
+ * block before it is known to be in use (free neighbors are merged first).
+ * @flags may carry FIRST and TRIMMED.
+ */
+static void make_free(block_t *b, size_t size, size_t flags)
+{
+    b->size = size | flags | PREV_ALLOC;
+    *footer(b) = size;
+    clear_prev_alloc(next_block(b));
+    insert_free_tree(&root, b);
+}
+
+static int heap_grow(size_t need)
+{
+    size_t len = ALIGN_UP(need + ARENA_HDR + HDR, ARENA_SIZE);
+    arena_t *a = mmap(NULL, len, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (a == MAP_FAILED)
+        return -1;
+
+    if (!page_size)
+        page_size = sysconf(_SC_PAGESIZE);
+    a->len = len;
+    a->prev = NULL;
+    a->next = arenas;
+    if (arenas)
+        arenas->prev = a;
+    arenas = a;
+    narenas++;
+
+    /* Fresh pages are not resident yet, hence TRIMMED. */
+    block_t *b = (block_t *) ((char *) a + ARENA_HDR);
+    ((block_t *) ((char *) a + len - HDR))->size = ALLOC; /* end of arena */
+    make_free(b, len - ARENA_HDR - HDR, FIRST | TRIMMED);
+
+    stats.heap_bytes += len;
+    return 0;
+}
+
+/* Unmap the arena that the free block @b spans entirely. */
+static void arena_release(block_t *b)
+{
+    arena_t *a = (arena_t *) ((char *) b - ARENA_HDR);
+
+    if (a->prev)
+        a->prev->next = a->next;
+    else
+        arenas = a->next;
+    if (a->next)
+        a->next->prev = a->prev;
+    narenas--;
+
+    stats.heap_bytes -= a->len;
+    stats.returned_bytes += a->len;
+    munmap(a, a->len);
+}
+
+#define PAGE_DOWN(p) ((char *) ((uintptr_t) (p) & ~(page_size - 1)))
+#define PAGE_UP(p) PAGE_DOWN((char *) (p) + page_size - 1)
+
+/* Give back the pages touching [@lo, @hi) that lie wholly inside the free
+ * block at @b of @size bytes, away from its header, links and footer. The
+ * range is rounded outwards: the rest of the block is free as well.
+ */
+static void trim(block_t *b, size_t size, char *lo, char *hi)
+{
+    char *start = PAGE_UP(b + 1), *end = PAGE_DOWN((char *) b + size - HDR);
+
+    lo = PAGE_DOWN(lo);
+    hi = PAGE_UP(hi);
+    if (lo < start)
+        lo = start;
+    if (hi > end)
+        hi = end;
+    if (lo < hi && !madvise(lo, hi - lo, MADV_DONTNEED))
+        stats.returned_bytes += hi - lo;
+}
+
+/* Hand the free block @b of @size bytes back to the system or to the tree.
+ * Only [@lo, @hi) may have been touched since its pages were last released.
+ */
+static void release(block_t *b, size_t size, size_t flags, char *lo, char *hi)
+{
+    block_t *end = (block_t *) ((char *) b + size);
+
+    if ((flags & FIRST) && !bsize(end) && narenas > 1) {
+        arena_release(b);
+        return;
+    }
+    flags &= ~TRIMMED;
+    if (size >= TRIM_THRESHOLD) {
+        trim(b, size, lo, hi);
+        flags |= TRIMMED;
+    }
+    make_free(b, size, flags);
+}
+
+/* Mark the first @size bytes of @b as allocated and free the tail if it is
+ * large enough to be a block on its own. The tail keeps the TRIMMED state of
+ * @b: only the header written into it has been touched.
+ */
+static void carve(block_t *b, size_t size)
+{
+    size_t total = bsize(b), flags = b->size & (PREV_ALLOC | FIRST);
+
+    if (total - size >= MIN_BLOCK) {
+        size_t trimmed = b->size & TRIMMED;
+        b->size = size | flags | ALLOC;
+        make_free(next_block(b), total - size, trimmed);
+    } else {
+        b->size = total | flags | ALLOC;
+        set_prev_alloc(next_block(b));
+    }
+}
+
+static inline size_t block_size_for(size_t size)
+{
+    if (size > SIZE_MAX / 2)
+        return 0;
+    size = ALIGN_UP(size + HDR, FT_ALIGN);
+    return size < MIN_BLOCK ? MIN_BLOCK : size;
+}
+
+/* Take a block of at least @need bytes out of the tree. Lock held. */
+static block_t *tree_alloc(size_t need)
+{
+    block_t **link = find_free_tree(&root, need);
+    if (!link) {
+        if (heap_grow(need) < 0)
+            return NULL;
+        link = find_free_tree(&root, need);
+    }
+
+    block_t *b = *link;
+    remove_free_tree(&root, b);
+    carve(b, need);
+    return b;
+}
+
+/* Return an allocated block to the tree, merging it with free neighbors.
+ * Lock held.
+ */
+static void tree_free(block_t *b)
+{
+    size_t size = bsize(b);
+    char *lo = (char *) b, *hi = (char *) b + size;
+    assert(b->size & ALLOC);
+
+    /* A trimmed successor kept its header and links resident. Payloads are
+     * FT_ALIGN'ed, so the links can start the page after the header; once
+     * merged they are interior and that page goes back too.
+     */
+    block_t *next = next_block(b);
+    if (!(next->size & ALLOC)) {
+        remove_free_tree(&root, next);
+        size += bsize(next);
+        hi = next->size & TRIMMED ? (char *) (next + 1) : (char *) b + size;
+    }
+    if (!(b->size & PREV_ALLOC)) {
+        size_t prev_size = *((size_t *) b - 1);
+        b = (block_t *) ((char *) b - prev_size);
+        remove_free_tree(&root, b);
+        size += prev_size;
+        if (!(b->size & TRIMMED))
+            lo = (char *) b;
+    }
+    release(b, size, b->size & FIRST, lo, hi);
+}
+
+/* Size-class front end
+ *
+ * Blocks of up to SMALL_MAX bytes (payloads of up to 256 bytes) are served
+ * from per-thread LIFO lists, one per FT_ALIGN-spaced class, in O(1) and
+ * without taking the heap lock. Cached blocks stay marked as allocated, so
+ * the tree never merges them. An empty list is refilled with a whole batch
+ * carved from a single tree block; a list that grows past twice the batch
+ * size gives half of it back to the tree, where it can be coalesced again.
+ */
+#define NCLASSES 16
+#define SMALL_MAX (MIN_BLOCK + (NCLASSES - 1) * FT_ALIGN)
+#define REFILL_BYTES 4096
+
+#define class_of(size) (((size) - MIN_BLOCK) / FT_ALIGN)
+#define class_size(c) (MIN_BLOCK + (c) * FT_ALIGN)
+#define batch_of(c) (REFILL_BYTES / class_size(c))
+
+typedef struct {
+    block_t *head[NCLASSES]; /* chained through ->l */
+    unsigned count[NCLASSES];
+    int registered;
+} tcache_t;
+
+static pthread_mutex_t heap_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t tcache_once = PTHREAD_ONCE_INIT;
+static pthread_key_t tcache_key;
+static __thread tcache_t tcache;
+
+static inline void tcache_push(tcache_t *tc, block_t *b, size_t c)
+{
+    b->l = tc->head[c];
+    tc->head[c] = b;
+    tc->count[c]++;
+}
+
+/* Give @n blocks of class @c back to the tree. */
+static void tcache_flush(tcache_t *tc, size_t c, unsigned n)
+{
+    pthread_mutex_lock(&heap_lock);
+    while (n-- && tc->head[c]) {
+        block_t *b = tc->head[c];
+        tc->head[c] = b->l;
+        tc->count[c]--;
+        tree_free(b);
+    }
+    pthread_mutex_unlock(&heap_lock);
+}
+
+static void tcache_destroy(void *arg)
+{
+    tcache_t *tc = arg;
+    for (size_t c = 0; c < NCLASSES; c++)
+        tcache_flush(tc, c, tc->count[c]);
+}
+
+static void tcache_key_init(void)
+{
+    pthread_key_create(&tcache_key, tcache_destroy);
+}
+
+static inline tcache_t *tcache_get(void)
+{
+    tcache_t *tc = &tcache;
+
+    if (!tc->registered) {
+        /* Flush the lists back to the tree when the thread exits. */
+        pthread_once(&tcache_once, tcache_key_init);
+        pthread_setspecific(tcache_key, tc);
+        tc->registered = 1;
+    }
+    return tc;
+}
+
+static int tcache_refill(tcache_t *tc, size_t c)
+{
+    size_t size = class_size(c);
+    unsigned n = batch_of(c);
+
+    pthread_mutex_lock(&heap_lock);
+    block_t *run = tree_alloc(n * size);
+    if (!run) {
+        pthread_mutex_unlock(&heap_lock);
+        return -1;
+    }
+
+    /* Cut the run into blocks of the class size. The last one also takes
+     * whatever carve() left over and may land in a larger class. Headers are
+     * written under the lock: a neighbor being freed may touch them too.
+     */
+    size_t total = bsize(run), flags = run->size & (PREV_ALLOC | FIRST);
+    char *p = (char *) run;
+    for (unsigned i = 0; i < n; i++) {
+        block_t *b = (block_t *) p;
+        size_t bs = i + 1 < n ? size : total - (n - 1) * size;
+        b->size = bs | ALLOC | (i ? PREV_ALLOC : flags);
+        p += bs;
+        if (bs <= SMALL_MAX)
+            tcache_push(tc, b, class_of(bs));
+        else
+            tree_free(b);
+    }
+    pthread_mutex_unlock(&heap_lock);
+    return 0;
+}
+
+void *ft_malloc(size_t size)
+{
+    size_t need = block_size_for(size);
+    block_t *b;
+
+    if (!need)
+        return NULL;
+
+    if (need <= SMALL_MAX) {
+        tcache_t *tc = tcache_get();
+        size_t c = class_of(need);
+        if (!tc->head[c] && tcache_refill(tc, c) < 0)
+            return NULL;
+        b = tc->head[c];
+        tc->head[c] = b->l;
+        tc->count[c]--;
+        return payload(b);
+    }
+
+    pthread_mutex_lock(&heap_lock);
+    b = tree_alloc(need);
+    pthread_mutex_unlock(&heap_lock);
+    return b ? payload(b) : NULL;
+}
+
+void ft_free(void *ptr)
+{
+    if (!ptr)
+        return;
+
+    block_t *b = from_payload(ptr);
+    size_t size = bsize_unlocked(b);
+
+    if (size <= SMALL_MAX) {
+        tcache_t *tc = tcache_get();
+        size_t c = class_of(size);
+        if (tc->count[c] >= 2 * batch_of(c))
+            tcache_flush(tc, c, batch_of(c));
+        tcache_push(tc, b, c);
+        return;
+    }
+
+    pthread_mutex_lock(&heap_lock);
+    tree_free(b);
+    pthread_mutex_unlock(&heap_lock);
+}
+
+/* Resize @b in place if it or its free successor is large enough. Lock held.
+ */
+static int tree_resize(block_t *b, size_t need)
+{
+    size_t cur = bsize(b);
+    block_t *next = next_block(b);
+
+    /* Grow into the free successor if that is enough. */
+    if (need > cur && !(next->size & ALLOC) && cur + bsize(next) >= need) {
+        remove_free_tree(&root, next);
+        b->size += bsize(next);
+        set_prev_alloc(next_block(b));
+        cur = bsize(b);
+    }
+
+    if (need > cur)
+        return -1;
+
+    if (cur - need >= MIN_BLOCK) {
+        /* Give the tail back, merged with a free successor if any. */
+        block_t *tail = (block_t *) ((char *) b + need);
+        size_t tail_size = cur - need;
+        char *hi = (char *) b + cur;
+        next = next_block(b);
+        if (!(next->size & ALLOC)) {
+            remove_free_tree(&root, next);
+            tail_size += bsize(next);
+            hi = next->size & TRIMMED ? (char *) (next + 1)
+                                      : (char *) tail + tail_size;
+        }
+        b->size = need | (b->size & FLAGS);
+        release(tail, tail_size, 0, (char *) tail, hi);
+    }
+    return 0;
+}
+
+void *ft_realloc(void *ptr, size_t size)
+{
+    if (!ptr)
+        return ft_malloc(size);
+    if (!size) {
+        ft_free(ptr);
+        return NULL;
+    }
+
+    size_t need = block_size_for(size);
+    if (!need)
+        return NULL;
+
+    block_t *b = from_payload(ptr);
+    size_t cur = bsize_unlocked(b);
+    int rc;
+
+    /* Small blocks keep their class; only move them when they outgrow it. */
+    if (cur <= SMALL_MAX && need <= cur)
+        return ptr;
+    if (cur <= SMALL_MAX && need <= SMALL_MAX) {
+        rc = -1;
+    } else {
+        pthread_mutex_lock(&heap_lock);
+        rc = tree_resize(b, need);
+        pthread_mutex_unlock(&heap_lock);
+    }
+    if (!rc)
+        return ptr;
+
+    void *p = ft_malloc(size);
+    if (!p)
+        return NULL;
+    memcpy(p, ptr, cur - HDR);
+    ft_free(ptr);
+    return p;
+}
+
+size_t ft_usable_size(void *ptr)
+{
+    return ptr ? bsize_unlocked(from_payload(ptr)) - HDR : 0;
+}
+
+void ft_get_stats(ft_stats_t *out)
+{
+    pthread_mutex_lock(&heap_lock);
+    *out = stats;
+    out->largest_free = 0;
+    for (block_t *b = root; b; b = b->r)
+        out->largest_free = bsize(b); /* (size, address) order: rightmost */
+    pthread_mutex_unlock(&heap_lock);
+}
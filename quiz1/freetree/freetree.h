@@ -0,0 +1,80 @@
+/* Best-fit memory allocator over a balanced tree of free blocks */
+
+#ifndef FREETREE_H
+#define FREETREE_H
+
+#include <stddef.h>
+
+/* Every free block is a node of the free tree. Allocated blocks only keep the
+ * size word; the payload starts where the child pointers would be.
+ *
+ * The low bits of size are flags, since block sizes are multiples of
+ * FT_ALIGN.
+ */
+typedef struct block {
+    size_t size;
+    struct block *l, *r;
+} block_t;
+
+/* Payload alignment and block size granularity */
+#define FT_ALIGN 16
+
+/** Allocate @size bytes
+ *
+ * Requests of up to 256 bytes are served in O(1) from per-thread size-class
+ * caches; larger ones take the best fit from the shared free tree. All
+ * functions are thread-safe.
+ *
+ * \param size The number of bytes to allocate
+ * \returns A FT_ALIGN-aligned pointer, or NULL if the request cannot be served
+ */
+void *ft_malloc(size_t size);
+
+/** Release memory obtained from ft_malloc() or ft_realloc()
+ *
+ * The block is merged with its address-adjacent free neighbors before it goes
+ * back into the free tree. Passing NULL is a no-op.
+ *
+ * \param ptr The pointer to release
+ */
+void ft_free(void *ptr);
+
+/** Resize an allocation, in place when the block or its free successor is
+ * large enough
+ *
+ * \param ptr  The pointer to resize, or NULL to allocate
+ * \param size The new size in bytes
+ * \returns The (possibly moved) pointer, or NULL if the request cannot be
+ * served, in which case @ptr is left untouched
+ */
+void *ft_realloc(void *ptr, size_t size);
+
+/** Return the usable size of an allocation */
+size_t ft_usable_size(void *ptr);
+
+/** Locate the best-fitting free block
+ *
+ * \param root The free tree
+ * \param size The block size needed, header included
+ * \returns The link pointing at the smallest free block of at least @size
+ * bytes (the lowest-addressed one among equals), or NULL if there is none
+ */
+block_t **find_free_tree(block_t **root, size_t size);
+
+/* Searches visiting FT_DEPTH_HIST - 1 nodes or more share the last bucket */
+#define FT_DEPTH_HIST 64
+
+/** Heap usage counters */
+typedef struct {
+    size_t heap_bytes;     /* bytes currently mapped from the system */
+    size_t free_bytes;     /* bytes held in the free tree */
+    size_t free_blocks;    /* number of blocks in the free tree */
+    size_t largest_free;   /* size of the largest free block */
+    size_t returned_bytes; /* bytes handed back with munmap() or madvise() */
+    /* depth_hist[d]: find_free_tree() calls that visited d nodes */
+    size_t depth_hist[FT_DEPTH_HIST];
+} ft_stats_t;
+
+void ft_get_stats(ft_stats_t *stats);
+
+#endif /* FREETREE_H */
@@ -0,0 +1,280 @@
+/* Replay recorded allocation traces against the free-tree allocator
+ *
+ * Usage: replay [-a freetree|glibc] <trace>
+ *
+ * A trace is a text file with one request per line:
+ *
+ *   m <id> <size>   malloc(size), remembered as <id>
+ *   r <id> <size>   realloc() the block <id> to size
+ *   f <id>          free() the block <id>
+ *
+ * Blank lines, including ones of only spaces or a CR, and lines starting
+ * with '#' are ignored; a line longer than 255 bytes is an error. Ids are
+ * small non-negative integers and may be reused once freed. The whole trace
+ * is parsed before the clock starts, and the clock is stopped while the heap
+ * is sampled for fragmentation.
+ *
+ * Reported: throughput, peak RSS of the replay, external fragmentation
+ * (1 - largest free block / free bytes) at the heap's high-water mark, and
+ * for the free-tree allocator the distribution of nodes visited by
+ * find_free_tree().
+ */
+
+#include <errno.h>
+#include <malloc.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "freetree.h"
+
+#define MAX_ID (1U << 26)
+
+typedef struct {
+    char type;
+    uint32_t id;
+    size_t size;
+} op_t;
+
+typedef struct {
+    const char *name;
+    void *(*malloc)(size_t);
+    void *(*realloc)(void *, size_t);
+    void (*free)(void *);
+} allocator_t;
+
+static const allocator_t allocators[] = {
+    {"freetree", ft_malloc, ft_realloc, ft_free},
+    {"glibc", malloc, realloc, free},
+};
+
+static op_t *load_trace(const char *path, size_t *nops, uint32_t *max_id)
+{
+    FILE *f = fopen(path, "r");
+    char line[256];
+    size_t n = 0, cap = 1 << 16, lineno = 0;
+    op_t *ops;
+
+    if (!f) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return NULL;
+    }
+    ops = malloc(cap * sizeof(op_t));
+    *max_id = 0;
+
+    while (ops && fgets(line, sizeof(line), f)) {
+        op_t op = {0};
+        unsigned long id;
+        int fields;
+
+        lineno++;
+        /* A line cut by the buffer would be parsed as two requests */
+        if (!strchr(line, '\n') && getc(f) != EOF) {
+            fprintf(stderr, "%s:%zu: line too long\n", path, lineno);
+            free(ops);
+            ops = NULL;
+            break;
+        }
+        const char *p = line + strspn(line, " \t\r\n\v\f");
+        if (*p == '#' || !*p)
+            continue;
+        fields = sscanf(p, "%c %lu %zu", &op.type, &id, &op.size);
+        if (!((fields == 3 && (op.type == 'm' || op.type == 'r')) ||
+              (fields >= 2 && op.type == 'f')) ||
+            id >= MAX_ID) {
+            fprintf(stderr, "%s:%zu: malformed request\n", path, lineno);
+            free(ops);
+            ops = NULL;
+            break;
+        }
+        op.id = id;
+        if (op.id > *max_id)
+            *max_id = op.id;
+
+        if (n == cap) {
+            op_t *tmp = realloc(ops, (cap *= 2) * sizeof(op_t));
+            if (!tmp) {
+                free(ops);
+                ops = NULL;
+                break;
+            }
+            ops = tmp;
+        }
+        ops[n++] = op;
+    }
+    fclose(f);
+    *nops = n;
+    return ops;
+}
+
+/* Read a "VmXXX:" field of /proc/self/status, in KiB. */
+static long proc_status_kb(const char *field)
+{
+    FILE *f = fopen("/proc/self/status", "r");
+    char line[128];
+    long kb = -1;
+    size_t len = strlen(field);
+
+    if (!f)
+        return -1;
+    while (fgets(line, sizeof(line), f)) {
+        if (!strncmp(line, field, len)) {
+            kb = strtol(line + len + 1, NULL, 10);
+            break;
+        }
+    }
+    fclose(f);
+    return kb;
+}
+
+/* Reset VmHWM to the current RSS so that the trace itself is not counted. */
+static void reset_peak_rss(void)
+{
+    FILE *f = fopen("/proc/self/clear_refs", "w");
+    if (f) {
+        fputs("5", f);
+        fclose(f);
+    }
+}
+
+static double elapsed(const struct timespec *t0, const struct timespec *t1)
+{
+    return (t1->tv_sec - t0->tv_sec) + (t1->tv_nsec - t0->tv_nsec) * 1e-9;
+}
+
+static double fragmentation(int is_ft, size_t *heap)
+{
+    if (is_ft) {
+        ft_stats_t st;
+        ft_get_stats(&st);
+        *heap = st.heap_bytes;
+        return st.free_bytes ? 1.0 - (double) st.largest_free / st.free_bytes
+                             : 0.0;
+    }
+    /* glibc does not expose its largest free chunk. */
+    struct mallinfo2 mi = mallinfo2();
+    *heap = mi.arena + mi.hblkhd;
+    return -1.0;
+}
+
+int main(int argc, char **argv)
+{
+    const allocator_t *a = &allocators[0];
+    const char *path = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-a") && i + 1 < argc) {
+            a = NULL;
+            for (size_t j = 0; j < sizeof(allocators) / sizeof(allocators[0]);
+                 j++) {
+                if (!strcmp(argv[i + 1], allocators[j].name))
+                    a = &allocators[j];
+            }
+            i++;
+        } else {
+            path = argv[i];
+        }
+    }
+    if (!a || !path) {
+        fprintf(stderr, "Usage: %s [-a freetree|glibc] <trace>\n", argv[0]);
+        return 1;
+    }
+
+    size_t n;
+    uint32_t max_id;
+    op_t *ops = load_trace(path, &n, &max_id);
+    if (!ops)
+        return 1;
+    if (!n) {
+        fprintf(stderr, "%s: no requests\n", path);
+        free(ops);
+        return 1;
+    }
+    void **blocks = calloc((size_t) max_id + 1, sizeof(void *));
+    if (!blocks) {
+        free(ops);
+        return 1;
+    }
+
+    int is_ft = a->malloc == ft_malloc;
+    size_t heap = 0, heap_base, peak_heap = 0, sample_every = n / 1000 + 1;
+    double frag_at_peak = fragmentation(is_ft, &heap_base);
+    long rss_base = proc_status_kb("VmRSS");
+    struct timespec t0, t1;
+    double sec = 0;
+
+    reset_peak_rss();
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (size_t i = 0; i < n; i++) {
+        const op_t *op = &ops[i];
+        void **slot = &blocks[op->id];
+
+        switch (op->type) {
+        case 'm':
+            *slot = a->malloc(op->size);
+            break;
+        case 'r': {
+            /* On failure the block is still there, to be freed later */
+            void *p = a->realloc(*slot, op->size);
+            if (p || !op->size)
+                *slot = p;
+            break;
+        }
+        case 'f':
+            a->free(*slot);
+            *slot = NULL;
+            break;
+        }
+        if (i % sample_every == 0) {
+            /* ft_get_stats() locks and walks the heap; not the replay's cost */
+            clock_gettime(CLOCK_MONOTONIC, &t1);
+            sec += elapsed(&t0, &t1);
+            double frag = fragmentation(is_ft, &heap);
+            if (heap > heap_base && heap - heap_base > peak_heap) {
+                peak_heap = heap - heap_base;
+                frag_at_peak = frag;
+            }
+            clock_gettime(CLOCK_MONOTONIC, &t0);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    sec += elapsed(&t0, &t1);
+
+    long hwm = proc_status_kb("VmHWM");
+
+    printf("allocator     %s\n", a->name);
+    printf("requests      %zu\n", n);
+    printf("throughput    %.2f Mops/s (%.1f ns/op)\n", n / sec / 1e6,
+           sec * 1e9 / n);
+    printf("peak RSS      %.1f MiB (%.1f MiB above start)\n", hwm / 1024.0,
+           (hwm - rss_base) / 1024.0);
+    printf("peak heap     %.1f MiB\n", peak_heap / 1048576.0);
+    if (frag_at_peak >= 0)
+        printf("external frag %.1f%% at peak heap\n", 100 * frag_at_peak);
+
+    if (is_ft) {
+        ft_stats_t st;
+        size_t calls = 0, acc = 0;
+
+        ft_get_stats(&st);
+        for (int d = 0; d < FT_DEPTH_HIST; d++)
+            calls += st.depth_hist[d];
+        printf("find_free_tree depth (%zu searches)\n", calls);
+        for (int d = 0; d < FT_DEPTH_HIST && calls; d++) {
+            if (!st.depth_hist[d])
+                continue;
+            acc += st.depth_hist[d];
+            printf("  %2d%s %10zu  %5.1f%%  cum %5.1f%%\n", d,
+                   d == FT_DEPTH_HIST - 1 ? "+" : " ", st.depth_hist[d],
+                   100.0 * st.depth_hist[d] / calls, 100.0 * acc / calls);
+        }
+    }
+
+    for (uint32_t id = 0; id <= max_id; id++)
+        a->free(blocks[id]);
+    free(blocks);
+    free(ops);
+    return 0;
+}
@@ -0,0 +1,128 @@
+/* List sort through a contiguous array of (key, node) pairs */
+
+#ifndef LIST_ASORT_H
+#define LIST_ASORT_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "list_sort.h"
+
+/*
+ * Every pass of an in-place list sort chases ->next pointers through nodes
+ * scattered over the heap, one cache miss per node. list_asort() visits
+ * each node only twice: once to copy its key and address into an array, and
+ * once to relink it in order. In between, the array is sorted with an LSD
+ * radix sort on the 64-bit keys, which streams through memory. Bytes that
+ * are the same in every key are skipped, so narrow keys cost fewer passes.
+ *
+ * The price is 32 bytes of temporary memory per node. Below @threshold
+ * nodes, or if that memory cannot be had, the list is sorted in place with
+ * list_sort() instead. Both paths are stable.
+ *
+ * Keys are compared as unsigned integers. For a signed key, return it with
+ * the sign bit flipped: (uint64_t) v ^ (1ULL << 63).
+ */
+
+/* Lists shorter than this gain little from the copy. */
+#define LIST_ASORT_THRESHOLD 1024
+
+typedef struct {
+    uint64_t key;
+    struct list_head *node;
+} _list_asort_pair_t;
+
+typedef struct {
+    list_key_func_t key;
+} _list_asort_priv_t;
+
+static int _list_asort_cmp(void *priv,
+                           const struct list_head *a,
+                           const struct list_head *b)
+{
+    list_key_func_t key = ((_list_asort_priv_t *) priv)->key;
+    uint64_t ka = key(a), kb = key(b);
+    return (ka > kb) - (ka < kb);
+}
+
+/* Stable LSD radix sort of @a through @tmp; returns whichever holds the
+ * result.
+ */
+static inline _list_asort_pair_t *_list_asort_radix(_list_asort_pair_t *a,
+                                                    _list_asort_pair_t *tmp,
+                                                    size_t n)
+{
+    size_t count[8][256] = {{0}};
+
+    for (size_t i = 0; i < n; i++) {
+        uint64_t k = a[i].key;
+        for (int b = 0; b < 8; b++)
+            count[b][(k >> (8 * b)) & 0xff]++;
+    }
+
+    for (int b = 0; b < 8; b++) {
+        size_t *c = count[b], sum = 0;
+        if (c[(a[0].key >> (8 * b)) & 0xff] == n)
+            continue; /* every key has the same byte here */
+        for (int d = 0; d < 256; d++) {
+            size_t t = c[d];
+            c[d] = sum;
+            sum += t;
+        }
+        for (size_t i = 0; i < n; i++)
+            tmp[c[(a[i].key >> (8 * b)) & 0xff]++] = a[i];
+        _list_asort_pair_t *t = a;
+        a = tmp;
+        tmp = t;
+    }
+    return a;
+}
+
+/**
+ * Sorts a list in place by an integer key, stably.
+ *
+ * @head : Pointer to the list head.
+ * @key : Function returning the sort key of a node.
+ * @threshold : Minimum length for the array path; 0 always takes it,
+ * SIZE_MAX never does. LIST_ASORT_THRESHOLD is a reasonable default.
+ */
+static inline void list_asort(struct list_head *head,
+                              list_key_func_t key,
+                              size_t threshold)
+{
+    _list_asort_priv_t priv = {key};
+    _list_asort_pair_t *a = NULL;
+    struct list_head *node;
+    size_t n = 0;
+
+    list_for_each (node, head)
+        n++;
+    if (n >= threshold && n > 1 && n <= SIZE_MAX / (2 * sizeof(*a)))
+        a = malloc(2 * n * sizeof(*a));
+    if (!a) {
+        list_sort(&priv, head, _list_asort_cmp);
+        return;
+    }
+
+    size_t i = 0;
+    list_for_each (node, head)
+        a[i++] = (_list_asort_pair_t){key(node), node};
+
+    _list_asort_pair_t *s = _list_asort_radix(a, a + n, n);
+
+    /* Relink, fetching nodes a few steps ahead of the writes. */
+    struct list_head *prev = head;
+    for (i = 0; i < n; i++) {
+        if (i + 8 < n)
+            __builtin_prefetch(s[i + 8].node, 1);
+        node = s[i].node;
+        node->prev = prev;
+        prev->next = node;
+        prev = node;
+    }
+    prev->next = head;
+    head->prev = prev;
+    free(a);
+}
+
+#endif /* LIST_ASORT_H */
@@ -0,0 +1,301 @@
+/* Parallel stable sort for long struct list_head lists */
+
+#ifndef LIST_PSORT_H
+#define LIST_PSORT_H
+
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "list_sort.h"
+
+/*
+ * list_psort() sorts with the same contract as list_sort(), in three phases
+ * that each run on @nthreads threads:
+ *
+ *  1. The list is cut into P consecutive slices, which are sorted with
+ *     list_sort(). Each thread then picks P - 1 evenly spaced samples of
+ *     its slice.
+ *  2. The P * (P - 1) samples, P sorted runs already, are merged and every
+ *     (P - 1)-th one becomes a splitter, dividing the key space into P
+ *     ranges of about n / P nodes. Each thread cuts its sorted slice at the
+ *     splitters in one walk.
+ *  3. Thread j merges the j-th piece of every slice with a P-way heap
+ *     merge. The P outputs cover disjoint, increasing key ranges and are
+ *     simply chained together.
+ *
+ * The serial work is walking the list to count and cut it, merging the
+ * samples, which takes about P^2 log P comparisons, and the final ->prev
+ * relink; every other comparison happens on the workers. Nodes that compare
+ * equal land in the same range and ties are broken by slice order, so the
+ * sort is stable.
+ *
+ * Lists too short to be worth the threads are handed to list_sort(). A
+ * thread that cannot be created has its share run by the caller.
+ */
+
+#define LIST_PSORT_MAX_THREADS 64
+#define LIST_PSORT_MIN_PER_THREAD 16384
+
+typedef struct _list_psort_ctx _list_psort_ctx_t;
+
+typedef struct {
+    _list_psort_ctx_t *ctx;
+    int id;
+    struct list_head head; /* phase 1: the slice */
+    size_t n;
+    struct list_head *sample[LIST_PSORT_MAX_THREADS - 1];
+    struct list_head *piece[LIST_PSORT_MAX_THREADS]; /* phase 2 output */
+    struct list_head *out, *out_tail;                /* phase 3 output */
+    pthread_t tid;
+} _list_psort_worker_t;
+
+struct _list_psort_ctx {
+    void *priv;
+    list_cmp_func_t cmp;
+    int p;
+    _list_psort_worker_t *w;
+    struct list_head *split[LIST_PSORT_MAX_THREADS - 1];
+};
+
+static void *_list_psort_slice(void *arg)
+{
+    _list_psort_worker_t *w = arg;
+    _list_psort_ctx_t *ctx = w->ctx;
+    struct list_head *node = &w->head;
+    int k = 0;
+
+    /* Slices hold LIST_PSORT_MIN_PER_THREAD nodes or more. */
+    list_sort(ctx->priv, &w->head, ctx->cmp);
+    for (size_t i = 0; k < ctx->p - 1; i++) {
+        node = node->next;
+        if (i == (k + 1) * w->n / ctx->p)
+            w->sample[k++] = node;
+    }
+    return NULL;
+}
+
+static void *_list_psort_cut(void *arg)
+{
+    _list_psort_worker_t *w = arg;
+    _list_psort_ctx_t *ctx = w->ctx;
+    struct list_head *node = w->head.next, *prev = NULL;
+    int j = 0;
+
+    for (int k = 0; k < ctx->p; k++)
+        w->piece[k] = NULL;
+    w->head.prev->next = NULL;
+
+    for (; node; prev = node, node = node->next) {
+        int k = j;
+        while (k < ctx->p - 1 && ctx->cmp(ctx->priv, node, ctx->split[k]) > 0)
+            k++;
+        if (k != j || !w->piece[j]) {
+            if (prev)
+                prev->next = NULL;
+            j = k;
+            w->piece[j] = node;
+        }
+    }
+    return NULL;
+}
+
+/* Heap entries order by node, then by slice to keep the merge stable. */
+static inline int _list_psort_before(_list_psort_ctx_t *ctx,
+                                     struct list_head *a,
+                                     int ia,
+                                     struct list_head *b,
+                                     int ib)
+{
+    int c = ctx->cmp(ctx->priv, a, b);
+    return c < 0 || (c == 0 && ia < ib);
+}
+
+static void *_list_psort_merge(void *arg)
+{
+    _list_psort_worker_t *w = arg;
+    _list_psort_ctx_t *ctx = w->ctx;
+    struct list_head *heap[LIST_PSORT_MAX_THREADS];
+    int src[LIST_PSORT_MAX_THREADS], n = 0;
+    struct list_head **tail = &w->out;
+
+    for (int i = 0; i < ctx->p; i++) {
+        struct list_head *node = ctx->w[i].piece[w->id];
+        if (!node)
+            continue;
+        /* Sift up */
+        int c = n++;
+        while (c && _list_psort_before(ctx, node, i, heap[(c - 1) / 2],
+                                       src[(c - 1) / 2])) {
+            heap[c] = heap[(c - 1) / 2];
+            src[c] = src[(c - 1) / 2];
+            c = (c - 1) / 2;
+        }
+        heap[c] = node;
+        src[c] = i;
+    }
+
+    w->out = w->out_tail = NULL;
+    while (n) {
+        struct list_head *node = heap[0];
+        *tail = node;
+        tail = &node->next;
+        w->out_tail = node;
+
+        /* Replace the top with its successor, or the last entry. */
+        struct list_head *x = node->next;
+        int xs = src[0];
+        if (!x) {
+            x = heap[--n];
+            xs = src[n];
+        }
+        int c = 0;
+        for (;;) {
+            int m = 2 * c + 1;
+            if (m >= n)
+                break;
+            if (m + 1 < n && _list_psort_before(ctx, heap[m + 1], src[m + 1],
+                                                heap[m], src[m]))
+                m++;
+            if (!_list_psort_before(ctx, heap[m], src[m], x, xs))
+                break;
+            heap[c] = heap[m];
+            src[c] = src[m];
+            c = m;
+        }
+        heap[c] = x;
+        src[c] = xs;
+    }
+    return NULL;
+}
+
+/* Merge pairs of sorted runs of @len samples until @s is one run, using
+ * @tmp as scratch. Return whichever of the two holds the result.
+ */
+static struct list_head **_list_psort_merge_samples(_list_psort_ctx_t *ctx,
+                                                    struct list_head **s,
+                                                    struct list_head **tmp,
+                                                    int n,
+                                                    int len)
+{
+    for (; len < n; len *= 2) {
+        for (int lo = 0; lo < n; lo += 2 * len) {
+            int mid = lo + len < n ? lo + len : n;
+            int hi = lo + 2 * len < n ? lo + 2 * len : n;
+            int i = lo, j = mid, k = lo;
+            while (i < mid && j < hi) {
+                if (ctx->cmp(ctx->priv, s[i], s[j]) > 0)
+                    tmp[k++] = s[j++];
+                else
+                    tmp[k++] = s[i++];
+            }
+            while (i < mid)
+                tmp[k++] = s[i++];
+            while (j < hi)
+                tmp[k++] = s[j++];
+        }
+        struct list_head **t = s;
+        s = tmp;
+        tmp = t;
+    }
+    return s;
+}
+
+/* Run @fn on every worker, the first one on the calling thread. */
+static inline void _list_psort_phase(_list_psort_ctx_t *ctx,
+                                     void *(*fn)(void *))
+{
+    int started[LIST_PSORT_MAX_THREADS] = {0};
+
+    for (int i = 1; i < ctx->p; i++)
+        started[i] = !pthread_create(&ctx->w[i].tid, NULL, fn, &ctx->w[i]);
+    fn(&ctx->w[0]);
+    for (int i = 1; i < ctx->p; i++) {
+        if (started[i])
+            pthread_join(ctx->w[i].tid, NULL);
+        else
+            fn(&ctx->w[i]);
+    }
+}
+
+/**
+ * Sorts a list in place, stably, on up to @nthreads threads.
+ *
+ * @priv : Opaque pointer passed through to @cmp.
+ * @head : Pointer to the list head.
+ * @cmp : Comparison function: > 0 if @a sorts after @b, <= 0 otherwise. It
+ * is called concurrently from several threads.
+ * @nthreads : Number of threads to use, capped at LIST_PSORT_MAX_THREADS.
+ */
+static inline void list_psort(void *priv,
+                              struct list_head *head,
+                              list_cmp_func_t cmp,
+                              int nthreads)
+{
+    _list_psort_ctx_t ctx = {.priv = priv, .cmp = cmp};
+    struct list_head *node;
+    size_t n = 0;
+
+    list_for_each (node, head)
+        n++;
+    if (nthreads > LIST_PSORT_MAX_THREADS)
+        nthreads = LIST_PSORT_MAX_THREADS;
+    if (nthreads > (int) (n / LIST_PSORT_MIN_PER_THREAD))
+        nthreads = n / LIST_PSORT_MIN_PER_THREAD;
+    /* The workers, then room for the samples and a scratch copy */
+    int ns = nthreads * (nthreads - 1);
+    ctx.w = nthreads > 1 ? malloc(nthreads * sizeof(*ctx.w) +
+                                  2 * ns * sizeof(struct list_head *))
+                         : NULL;
+    if (!ctx.w) {
+        list_sort(priv, head, cmp);
+        return;
+    }
+    ctx.p = nthreads;
+
+    /* Cut the list into consecutive slices. */
+    node = head->next;
+    for (int i = 0; i < ctx.p; i++) {
+        _list_psort_worker_t *w = &ctx.w[i];
+        struct list_head *first = node, *last;
+        w->ctx = &ctx;
+        w->id = i;
+        w->n = n / ctx.p + (i < (int) (n % ctx.p));
+        for (size_t k = 1; k < w->n; k++)
+            node = node->next;
+        last = node;
+        node = node->next;
+        w->head.next = first;
+        w->head.prev = last;
+        first->prev = last->next = &w->head;
+    }
+    _list_psort_phase(&ctx, _list_psort_slice);
+
+    /* Every (P - 1)-th of the sorted samples splits the key space. */
+    struct list_head **samples = (struct list_head **) (ctx.w + ctx.p);
+    for (int i = 0; i < ctx.p; i++) {
+        for (int k = 0; k < ctx.p - 1; k++)
+            samples[i * (ctx.p - 1) + k] = ctx.w[i].sample[k];
+    }
+    samples = _list_psort_merge_samples(&ctx, samples, samples + ns, ns,
+                                        ctx.p - 1);
+    for (int j = 0; j < ctx.p - 1; j++)
+        ctx.split[j] = samples[(j + 1) * (ctx.p - 1)];
+
+    _list_psort_phase(&ctx, _list_psort_cut);
+    _list_psort_phase(&ctx, _list_psort_merge);
+
+    /* Chain the ranges and relink ->prev. */
+    struct list_head *prev = head;
+    for (int j = 0; j < ctx.p; j++) {
+        for (node = ctx.w[j].out; node; node = node->next) {
+            node->prev = prev;
+            prev->next = node;
+            prev = node;
+        }
+    }
+    prev->next = head;
+    head->prev = prev;
+    free(ctx.w);
+}
+
+#endif /* LIST_PSORT_H */
@@ -0,0 +1,71 @@
+/* LSD radix sort for struct list_head lists keyed by integers */
+
+#ifndef LIST_RADIX_H
+#define LIST_RADIX_H
+
+#include "list_sort.h"
+
+/*
+ * Each pass deals the nodes, in list order, into 256 bucket lists by one
+ * byte of their key, least significant byte first, and strings the buckets
+ * back together in byte order. Dealing keeps the order within a bucket, so
+ * after the pass for byte b the list is sorted by the low b + 1 bytes, and
+ * after the last one by the whole key.
+ *
+ * That is @key_bytes passes of O(n) with no comparisons at all, and nothing
+ * allocated: the buckets are singly linked through ->next and only their
+ * ends live on the stack. ->prev is rebuilt once at the end. A 16-bit key
+ * takes two passes.
+ *
+ * Keys are compared as unsigned integers, as in list_asort().
+ */
+
+/**
+ * Sorts a list in place by an integer key, stably.
+ *
+ * @head : Pointer to the list head.
+ * @key : Function returning the sort key of a node. Only its low
+ * @key_bytes bytes are looked at.
+ * @key_bytes : Width of the keys in bytes, 1 to 8.
+ */
+static inline void list_radix_sort(struct list_head *head,
+                                   list_key_func_t key,
+                                   int key_bytes)
+{
+    struct list_head *bucket[256], **tail[256], *list, *node;
+
+    if (list_empty(head))
+        return;
+    head->prev->next = NULL;
+    list = head->next;
+
+    for (int b = 0; b < key_bytes; b++) {
+        struct list_head **link = &list;
+
+        for (int d = 0; d < 256; d++)
+            tail[d] = &bucket[d];
+        for (node = list; node; node = node->next) {
+            unsigned d = (key(node) >> (8 * b)) & 0xff;
+            *tail[d] = node;
+            tail[d] = &node->next;
+        }
+        for (int d = 0; d < 256; d++) {
+            if (tail[d] == &bucket[d])
+                continue;
+            *link = bucket[d];
+            link = tail[d];
+        }
+        *link = NULL;
+    }
+
+    struct list_head *prev = head;
+    for (node = list; node; node = node->next) {
+        node->prev = prev;
+        prev->next = node;
+        prev = node;
+    }
+    prev->next = head;
+    head->prev = prev;
+}
+
+#endif /* LIST_RADIX_H */
@@ -0,0 +1,152 @@
+/* Stable bottom-up merge sort for struct list_head lists */
+
+#ifndef LIST_SORT_H
+#define LIST_SORT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "list.h"
+
+/*
+ * Same contract as the Linux kernel's list_sort(): @cmp returns > 0 when @a
+ * must come after @b, and nodes that compare equal keep their order.
+ *
+ * The list is cut into natural runs: maximal non-descending stretches, or
+ * strictly descending ones, which are reversed in place (strictly, so that
+ * equal nodes are never swapped). Runs are pushed on a stack of pending
+ * sorted lists, and the top two are merged while the top one is at least
+ * half as long as the one below. Pending lengths therefore at least double
+ * towards the bottom of the stack, which bounds it by log2(n) entries and
+ * keeps merges balanced: O(n log n) comparisons in general, and n - 1 for
+ * input that is already sorted or reversed.
+ *
+ * While sorting, the lists are NULL-terminated through ->next only; the
+ * ->prev links are rebuilt in a single pass at the end. No recursion, no
+ * allocation.
+ */
+
+typedef int (*list_cmp_func_t)(void *priv,
+                               const struct list_head *a,
+                               const struct list_head *b);
+
+/* Integer sort key of a node, for the sorts that need no comparator */
+typedef uint64_t (*list_key_func_t)(const struct list_head *node);
+
+/* Pending runs; 64 covers any length that fits in memory. */
+#define LIST_SORT_MAX_RUNS 64
+
+/* Merge two sorted NULL-terminated lists, @a's nodes first among equals. */
+static inline struct list_head *_list_sort_merge(void *priv,
+                                                 list_cmp_func_t cmp,
+                                                 struct list_head *a,
+                                                 struct list_head *b)
+{
+    struct list_head *head = NULL, **tail = &head;
+
+    for (;;) {
+        if (cmp(priv, a, b) <= 0) {
+            *tail = a;
+            tail = &a->next;
+            a = a->next;
+            if (!a) {
+                *tail = b;
+                break;
+            }
+        } else {
+            *tail = b;
+            tail = &b->next;
+            b = b->next;
+            if (!b) {
+                *tail = a;
+                break;
+            }
+        }
+    }
+    return head;
+}
+
+/* Detach the natural run starting at *@list and return it sorted. *@list is
+ * advanced past it and *@len receives its length.
+ */
+static inline struct list_head *_list_sort_run(void *priv,
+                                               list_cmp_func_t cmp,
+                                               struct list_head **list,
+                                               size_t *len)
+{
+    struct list_head *head = *list, *node = head, *next = head->next;
+    size_t n = 1;
+
+    if (!next) {
+        *list = NULL;
+        *len = 1;
+        return head;
+    }
+    if (cmp(priv, node, next) > 0) {
+        /* Strictly descending: reverse while walking. */
+        node->next = NULL;
+        do {
+            struct list_head *after = next->next;
+            next->next = node;
+            node = next;
+            next = after;
+            n++;
+        } while (next && cmp(priv, node, next) > 0);
+        *list = next;
+        *len = n;
+        return node;
+    }
+
+    do {
+        node = next;
+        next = next->next;
+        n++;
+    } while (next && cmp(priv, node, next) <= 0);
+    node->next = NULL;
+    *list = next;
+    *len = n;
+    return head;
+}
+
+/**
+ * Sorts a list in place, stably, with O(log n) bookkeeping.
+ *
+ * @priv : Opaque pointer passed through to @cmp.
+ * @head : Pointer to the list head.
+ * @cmp : Comparison function: > 0 if @a sorts after @b, <= 0 otherwise.
+ */
+static inline void list_sort(void *priv,
+                             struct list_head *head,
+                             list_cmp_func_t cmp)
+{
+    struct list_head *runs[LIST_SORT_MAX_RUNS], *list = head->next;
+    size_t lens[LIST_SORT_MAX_RUNS];
+    int top = 0;
+
+    if (list == head->prev)
+        return; /* zero or one node */
+    head->prev->next = NULL;
+
+    while (list) {
+        runs[top] = _list_sort_run(priv, cmp, &list, &lens[top]);
+        top++;
+        while (top > 1 && (!list || 2 * lens[top - 1] >= lens[top - 2])) {
+            runs[top - 2] =
+                _list_sort_merge(priv, cmp, runs[top - 2], runs[top - 1]);
+            lens[top - 2] += lens[top - 1];
+            top--;
+        }
+    }
+
+    /* Relink the ->prev pointers and close the ring. */
+    struct list_head *prev = head, *node;
+    for (node = runs[0]; node; node = node->next) {
+        node->prev = prev;
+        prev->next = node;
+        prev = node;
+    }
+    prev->next = head;
+    head->prev = prev;
+}
+
+#endif /* LIST_SORT_H */
@@ -0,0 +1,228 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "list_asort.h"
+#include "list_psort.h"
+#include "list_radix.h"
+
+#define my_assert(test, message) \
+    do {                         \
+        if (!(test))             \
+            return message;      \
+    } while (0)
+#define my_run_test(test)       \
+    do {                        \
+        char *message = test(); \
+        tests_run++;            \
+        if (message)            \
+            return message;     \
+    } while (0)
+
+#define N 100000
+
+typedef struct {
+    int key;
+    int seq; /* position before sorting, to check stability */
+    struct list_head list;
+} item_t;
+
+static item_t items[N];
+static struct list_head head;
+static size_t ncmp;
+
+static int cmp_key(void *priv,
+                   const struct list_head *a,
+                   const struct list_head *b)
+{
+    (void) priv;
+    /* Also called from the list_psort() workers */
+    __atomic_fetch_add(&ncmp, 1, __ATOMIC_RELAXED);
+    return list_entry(a, item_t, list)->key - list_entry(b, item_t, list)->key;
+}
+
+static uint64_t key_of(const struct list_head *node)
+{
+    return (uint64_t) list_entry(node, item_t, list)->key ^ (1ULL << 63);
+}
+
+enum { RANDOM, SORTED, REVERSED, FEW_UNIQUE, ORGAN_PIPE, SAWTOOTH };
+
+static void build(int pattern, size_t n)
+{
+    unsigned seed = 1;
+
+    INIT_LIST_HEAD(&head);
+    for (size_t i = 0; i < n; i++) {
+        int key;
+        switch (pattern) {
+        case SORTED:
+            key = i;
+            break;
+        case REVERSED:
+            key = n - i;
+            break;
+        case FEW_UNIQUE:
+            key = rand_r(&seed) % 4;
+            break;
+        case ORGAN_PIPE:
+            key = i < n / 2 ? i : n - i;
+            break;
+        case SAWTOOTH:
+            key = i % 1000;
+            break;
+        default:
+            key = rand_r(&seed);
+            break;
+        }
+        items[i].key = key;
+        items[i].seq = i;
+        list_add_tail(&items[i].list, &head);
+    }
+    ncmp = 0;
+}
+
+/* Sorted by key, equal keys in their original order, ring intact */
+static char *check(size_t n)
+{
+    struct list_head *node, *prev = &head;
+    const item_t *last = NULL;
+    size_t count = 0;
+
+    list_for_each (node, &head) {
+        const item_t *it = list_entry(node, item_t, list);
+        my_assert(node->prev == prev, "Broken prev link");
+        if (last) {
+            my_assert(last->key <= it->key, "List is not sorted");
+            my_assert(last->key < it->key || last->seq < it->seq,
+                      "Equal keys out of original order");
+        }
+        last = it;
+        prev = node;
+        count++;
+    }
+    my_assert(head.prev == prev, "Broken tail link");
+    my_assert(count == n, "Nodes lost or duplicated");
+    return NULL;
+}
+
+static char *test_patterns(void)
+{
+    const size_t sizes[] = {0, 1, 2, 3, 17, 1000, N};
+
+    for (int pattern = RANDOM; pattern <= SAWTOOTH; pattern++) {
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+            build(pattern, sizes[s]);
+            list_sort(NULL, &head, cmp_key);
+            char *msg = check(sizes[s]);
+            if (msg)
+                return msg;
+        }
+    }
+    return NULL;
+}
+
+static char *test_presorted_linear(void)
+{
+    build(SORTED, N);
+    list_sort(NULL, &head, cmp_key);
+    my_assert(ncmp == N - 1, "Sorted input should take n - 1 comparisons");
+
+    build(REVERSED, N);
+    list_sort(NULL, &head, cmp_key);
+    my_assert(ncmp == N - 1, "Reversed input should take n - 1 comparisons");
+
+    /* 100 ascending runs: one pass to find them, then ~log2(100) levels */
+    build(SAWTOOTH, N);
+    list_sort(NULL, &head, cmp_key);
+    my_assert(ncmp < 9 * N, "Run detection should cut comparisons");
+    return check(N);
+}
+
+static char *test_parallel(void)
+{
+    for (int pattern = RANDOM; pattern <= SAWTOOTH; pattern++) {
+        for (int t = 1; t <= 8; t++) {
+            build(pattern, N);
+            list_psort(NULL, &head, cmp_key, t);
+            char *msg = check(N);
+            if (msg)
+                return msg;
+        }
+    }
+    /* Below the per-thread minimum, one thread does it all. */
+    build(RANDOM, 1000);
+    list_psort(NULL, &head, cmp_key, 8);
+    return check(1000);
+}
+
+static char *test_array(void)
+{
+    const size_t sizes[] = {0, 1, 2, 3, 17, 1000, N};
+    const size_t thresholds[] = {0, LIST_ASORT_THRESHOLD, SIZE_MAX};
+
+    for (int pattern = RANDOM; pattern <= SAWTOOTH; pattern++) {
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+            for (size_t t = 0; t < 3; t++) {
+                build(pattern, sizes[s]);
+                list_asort(&head, key_of, thresholds[t]);
+                char *msg = check(sizes[s]);
+                if (msg)
+                    return msg;
+            }
+        }
+    }
+
+    /* Negative keys sort before positive ones. */
+    build(RANDOM, N);
+    for (size_t i = 0; i < N; i += 3)
+        items[i].key = -items[i].key;
+    list_asort(&head, key_of, 0);
+    return check(N);
+}
+
+static char *test_radix(void)
+{
+    const size_t sizes[] = {0, 1, 2, 3, 17, 1000, N};
+
+    for (int pattern = RANDOM; pattern <= SAWTOOTH; pattern++) {
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+            build(pattern, sizes[s]);
+            list_radix_sort(&head, key_of, 8);
+            char *msg = check(sizes[s]);
+            if (msg)
+                return msg;
+        }
+    }
+
+    /* 16-bit keys, as in quiz2/test1.c: two passes are enough. */
+    build(RANDOM, N);
+    for (size_t i = 0; i < N; i++)
+        items[i].key &= 0xffff;
+    list_radix_sort(&head, key_of, 2);
+    return check(N);
+}
+
+int tests_run = 0;
+
+static char *test_suite(void)
+{
+    my_run_test(test_patterns);
+    my_run_test(test_presorted_linear);
+    my_run_test(test_parallel);
+    my_run_test(test_array);
+    my_run_test(test_radix);
+    return NULL;
+}
+
+int main(void)
+{
+    printf("---=[ List sort tests\n");
+    char *result = test_suite();
+    if (result)
+        printf("ERROR: %s\n", result);
+    else
+        printf("ALL TESTS PASSED\n");
+    printf("Tests run: %d\n", tests_run);
+    return !!result;
+}
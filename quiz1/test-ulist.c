@@ -0,0 +1,172 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ulist.h"
+
+#define my_assert(test, message) \
+    do {                         \
+        if (!(test))             \
+            return message;      \
+    } while (0)
+#define my_run_test(test)       \
+    do {                        \
+        char *message = test(); \
+        tests_run++;            \
+        if (message)            \
+            return message;     \
+    } while (0)
+
+#define N 1000
+
+/* Reference contents: ref[0 .. nref) */
+static int ref[4 * N];
+static size_t nref;
+
+static int same(ulist_t *l, const int *want, size_t n)
+{
+    ulist_pos_t pos;
+    ulist_node_t *node;
+    size_t i = 0;
+
+    ulist_for_each (pos, l) {
+        if (i == n || *ulist_value(pos) != want[i])
+            return 0;
+        i++;
+    }
+    /* Links in both directions, tail and fill counts must agree. */
+    ulist_for_each_node (node, l) {
+        if (!node->count || node->count > ULIST_CAP)
+            return 0;
+        if (node->prev ? node->prev->next != node : l->head != node)
+            return 0;
+        if (!node->next && l->tail != node)
+            return 0;
+    }
+    return i == n && ulist_size(l) == n;
+}
+
+static ulist_pos_t nth(ulist_t *l, size_t k)
+{
+    ulist_pos_t pos = ulist_first(l);
+    while (pos.node && k >= pos.node->count - pos.idx) {
+        k -= pos.node->count - pos.idx;
+        pos = (ulist_pos_t){pos.node->next, 0};
+    }
+    pos.idx += k;
+    return pos;
+}
+
+static char *test_append_prepend(void)
+{
+    ulist_t l;
+
+    ulist_init(&l);
+    my_assert(ulist_size(&l) == 0, "Initial list size is expected to be zero.");
+    for (int i = 0; i < N; i++) {
+        my_assert(!ulist_push_back(&l, i), "Allocation failed");
+        ref[i] = i;
+    }
+    my_assert(same(&l, ref, N), "Appended values out of order");
+    ulist_destroy(&l);
+
+    for (int i = 0; i < N; i++) {
+        ulist_pos_t head = ulist_first(&l);
+        my_assert(!ulist_insert_before(&l, &head, i), "Allocation failed");
+        my_assert(*ulist_value(head) == i, "Position should hold new value");
+        ref[N - 1 - i] = i;
+    }
+    my_assert(same(&l, ref, N), "Prepended values out of order");
+    ulist_destroy(&l);
+    return NULL;
+}
+
+static char *test_random_ops(void)
+{
+    ulist_t l;
+    unsigned seed = 1;
+
+    ulist_init(&l);
+    nref = 0;
+    for (int step = 0; step < 20 * N; step++) {
+        size_t k = nref ? rand_r(&seed) % (nref + 1) : 0;
+
+        if (nref < 3 * N && (rand_r(&seed) % 3 || !nref)) {
+            ulist_pos_t pos = nth(&l, k);
+            my_assert(!ulist_insert_before(&l, &pos, step),
+                      "Allocation failed");
+            my_assert(*ulist_value(pos) == step,
+                      "Position should hold new value");
+            memmove(ref + k + 1, ref + k, (nref - k) * sizeof(int));
+            ref[k] = step;
+            nref++;
+        } else {
+            if (k == nref)
+                k--;
+            ulist_pos_t pos = ulist_erase(&l, nth(&l, k));
+            memmove(ref + k, ref + k + 1, (nref - k - 1) * sizeof(int));
+            nref--;
+            my_assert(k == nref ? !pos.node : *ulist_value(pos) == ref[k],
+                      "Erase should return the following position");
+        }
+        if (step % 97 == 0)
+            my_assert(same(&l, ref, nref), "List disagrees with reference");
+    }
+    my_assert(same(&l, ref, nref), "List disagrees with reference");
+    ulist_destroy(&l);
+    return NULL;
+}
+
+static char *test_split_merge(void)
+{
+    ulist_t l, tail;
+
+    ulist_init(&l);
+    for (int i = 0; i < N; i++) {
+        ulist_push_back(&l, i);
+        ref[i] = i;
+    }
+
+    for (size_t k = 0; k <= N; k += 37) {
+        my_assert(!ulist_split(&l, nth(&l, k), &tail), "Allocation failed");
+        my_assert(same(&l, ref, k), "Split head has wrong values");
+        my_assert(same(&tail, ref + k, N - k), "Split tail has wrong values");
+        ulist_merge(&l, &tail);
+        my_assert(!tail.head && !tail.tail, "Merged list should be empty");
+        my_assert(same(&l, ref, N), "Merge did not restore the list");
+    }
+
+    /* Splitting at the end moves nothing; merging into empty moves all. */
+    ulist_pos_t end = {NULL, 0};
+    ulist_split(&l, end, &tail);
+    my_assert(!tail.head && same(&l, ref, N), "Split at end should be no-op");
+    ulist_split(&l, ulist_first(&l), &tail);
+    my_assert(!l.head && same(&tail, ref, N), "Split at start moves all");
+    ulist_merge(&l, &tail);
+    my_assert(same(&l, ref, N), "Merge into empty list failed");
+
+    ulist_destroy(&l);
+    return NULL;
+}
+
+int tests_run = 0;
+
+static char *test_suite(void)
+{
+    my_run_test(test_append_prepend);
+    my_run_test(test_random_ops);
+    my_run_test(test_split_merge);
+    return NULL;
+}
+
+int main(void)
+{
+    printf("---=[ Unrolled list tests\n");
+    char *result = test_suite();
+    if (result)
+        printf("ERROR: %s\n", result);
+    else
+        printf("ALL TESTS PASSED\n");
+    printf("Tests run: %d\n", tests_run);
+    return !!result;
+}
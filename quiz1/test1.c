@@ -11,6 +11,15 @@ typedef struct {
     struct list_item *head;
 } list_t;
 
+/* Same list, but also tracking the link that ends it and the number of
+ * items, so that appending and counting are O(1).
+ */
+typedef struct {
+    struct list_item *head;
+    struct list_item **tail; /* &head when empty, else &last->next */
+    size_t size;
+} tlist_t;
+
 #define my_assert(test, message) \
     do {                         \
         if (!(test))             \
@@ -48,6 +57,35 @@ static void list_insert_before(list_t *l, list_item_t *before, list_item_t *item
     (*p)->next = before;
 }
 
+static tlist_t *tlist_reset(tlist_t *t)
+{
+    list_reset();
+    t->head = NULL;
+    t->tail = &t->head;
+    t->size = 0;
+    return t;
+}
+
+static void tlist_insert_before(tlist_t *t, list_item_t *before, list_item_t *item)
+{
+    list_item_t **p;
+    if (before) {
+        for (p = &(t->head); *p != before; p = &(*p)->next)
+            ;
+    } else {
+        p = t->tail;
+        t->tail = &item->next;
+    }
+    *p = item;
+    (*p)->next = before;
+    t->size++;
+}
+
+static inline size_t tlist_size(tlist_t *t)
+{
+    return t->size;
+}
+
 static int list_size(list_t *l)
 {
     if (!l || !(l->head))
@@ -101,11 +139,61 @@ static char *test_list(void)
     return NULL;
 }
 
+static char *test_tlist(void)
+{
+    tlist_t t;
+
+    /* Appending must match list_insert_before(&l, NULL, ...) */
+    tlist_reset(&t);
+    my_assert(tlist_size(&t) == 0, "Initial list size is expected to be zero.");
+    for (size_t i = 0; i < N; i++)
+        tlist_insert_before(&t, NULL, &items[i]);
+    my_assert(tlist_size(&t) == N, "Final list size should be N");
+    size_t k = 0;
+    for (list_item_t *cur = t.head; cur; cur = cur->next, k++)
+        my_assert(cur->value == (int) k, "Unexpected list item value");
+    my_assert(k == N, "Cached size disagrees with the list");
+    my_assert(*t.tail == NULL && t.tail == &items[N - 1].next,
+              "Tail should point at the last link");
+
+    /* Interleave: even values appended, odd ones inserted before their
+     * successor, which is already in the list.
+     */
+    tlist_reset(&t);
+    for (size_t i = 0; i < N; i += 2)
+        tlist_insert_before(&t, NULL, &items[i]);
+    for (size_t i = 1; i < N; i += 2) {
+        list_item_t *next = i + 1 < N ? &items[i + 1] : NULL;
+        tlist_insert_before(&t, next, &items[i]);
+    }
+    my_assert(tlist_size(&t) == N, "Final list size should be N");
+    k = 0;
+    for (list_item_t *cur = t.head; cur; cur = cur->next, k++)
+        my_assert(cur->value == (int) k, "Unexpected list item value");
+    my_assert(k == N, "Cached size disagrees with the list");
+
+    /* Prepending leaves the tail alone */
+    tlist_reset(&t);
+    tlist_insert_before(&t, NULL, &items[0]);
+    for (size_t i = 1; i < N - 1; i++)
+        tlist_insert_before(&t, t.head, &items[i]);
+    my_assert(t.tail == &items[0].next, "Tail should not move on prepend");
+    tlist_insert_before(&t, NULL, &items[N - 1]);
+    my_assert(tlist_size(&t) == N, "Final list size should be N");
+    k = N - 2;
+    for (list_item_t *cur = t.head; cur != &items[0]; cur = cur->next, k--)
+        my_assert(cur->value == (int) k, "Unexpected list item value");
+    my_assert(items[0].next == &items[N - 1] && !items[N - 1].next,
+              "Append after prepends should land at the end");
+    return NULL;
+}
+
 int tests_run = 0;
 
 static char *test_suite(void)
 {
     my_run_test(test_list);
+    my_run_test(test_tlist);
     return NULL;
 }
 
@@ -25,7 +25,7 @@ void remove_free_tree(block_t **root, block_t *target)
          * This is the rightmost node in the left subtree.
          */
         block_t **pred_ptr = &(*node_ptr)->l;
-        while (&(*pred_ptr)->r)
+        while ((*pred_ptr)->r)
             pred_ptr = &(*pred_ptr)->r;
 
         /* Verify the found predecessor using a helper function (for debugging).
@@ -41,16 +41,15 @@ void remove_free_tree(block_t **root, block_t *target)
             assert(*node_ptr != (*node_ptr)->l);
             assert(*node_ptr != (*node_ptr)->r);
         } else {
-            /* The predecessor is deeper in the left subtree. */
-            block_t *old_left = (*node_ptr)->l;
-            block_t *old_right = (*node_ptr)->r;
+            /* The predecessor is deeper in the left subtree. It has no right
+             * child, so unlink it by splicing in its left subtree.
+             */
             block_t *pred_node = *pred_ptr;
-            /* Remove the predecessor from its original location. */
-            remove_free_tree(&old_left, *pred_ptr);
+            *pred_ptr = pred_node->l;
             /* Replace the target node with the predecessor. */
+            pred_node->l = (*node_ptr)->l;
+            pred_node->r = (*node_ptr)->r;
             *node_ptr = pred_node;
-            (*node_ptr)->l = old_left;
-            (*node_ptr)->r = old_right;
             assert(*node_ptr != (*node_ptr)->l);
             assert(*node_ptr != (*node_ptr)->r);
         }
@@ -3,7 +3,10 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <assert.h>
+#include <stdint.h>
+#include <string.h>
 
+#include "../common/rng.h"
 #include "list.h"
 
 typedef struct __node {
@@ -29,6 +32,8 @@ void list_free(const struct list_head *head)
 /* Verify if list is order */
 static bool list_is_ordered(const struct list_head *head)
 {
+    if (list_empty(head))
+        return true;
     int value = list_entry(head->next, node_t, list)->value;
     node_t *entry;
     list_for_each_entry (entry, head, list) {
@@ -40,18 +45,12 @@ static bool list_is_ordered(const struct list_head *head)
     return true;
 }
 
-/* shuffle array, only work if n < RAND_MAX */
+static rng_t rng;
+
+/* shuffle array uniformly, for any n */
 void shuffle(int *array, size_t n)
 {
-    if (n <= 0)
-        return;
-
-    for (size_t i = 0; i < n - 1; i++) {
-        size_t j = i + rand() / (RAND_MAX / (n - i) + 1);
-        int t = array[j];
-        array[j] = array[i];
-        array[i] = t;
-    }
+    rng_shuffle(&rng, array, n, sizeof(array[0]));
 }
 
 struct list_head *list_tail(struct list_head *head)
@@ -133,23 +132,254 @@ void quick_sort(struct list_head *list)
     rebuild_list_link(list);
 }
 
+/* Stable merge of two NULL-terminated chains */
+static struct list_head *merge_chain(struct list_head *a, struct list_head *b)
+{
+    struct list_head *head = NULL, **tail = &head;
+
+    while (a && b) {
+        struct list_head **min =
+            list_entry(b, node_t, list)->value <
+                    list_entry(a, node_t, list)->value
+                ? &b
+                : &a;
+        *tail = *min;
+        tail = &(*min)->next;
+        *min = (*min)->next;
+    }
+    *tail = a ? a : b;
+    return head;
+}
+
+/* Bottom-up merge sort of a NULL-terminated chain. bins[i] holds a sorted run
+ * of 2^i nodes, so merging a new node in is adding one to a binary counter.
+ */
+static struct list_head *merge_sort_chain(struct list_head *head)
+{
+    struct list_head *bins[64] = {NULL}, *result = NULL;
+
+    while (head) {
+        struct list_head *run = head;
+        int i;
+
+        head = head->next;
+        run->next = NULL;
+        for (i = 0; bins[i]; i++) {
+            run = merge_chain(bins[i], run);
+            bins[i] = NULL;
+        }
+        bins[i] = run;
+    }
+    for (int i = 0; i < 64; i++) {
+        if (bins[i])
+            result = merge_chain(bins[i], result);
+    }
+    return result;
+}
+
+/* A run of @n unsorted nodes: *link points at the first and @tail is the
+ * last. @sample holds three of them drawn uniformly at random.
+ */
+struct segment {
+    struct list_head **link;
+    struct list_head *tail, *sample[3];
+    size_t n;
+    int depth;
+};
+
+/* Chain being built by appending, with a reservoir sample of its nodes */
+struct chain {
+    struct list_head *head, *tail, *sample[3];
+    size_t n;
+};
+
+/* Keep @node as a sample with probability 3 / n. */
+static inline void sample_add(struct list_head **sample,
+                              size_t n,
+                              struct list_head *node,
+                              rng_t *rng)
+{
+    if (n <= 3) {
+        sample[n - 1] = node;
+    } else {
+        size_t j = rng_bounded(rng, n);
+        if (j < 3)
+            sample[j] = node;
+    }
+}
+
+static inline void chain_add(struct chain *c,
+                             struct list_head *node,
+                             rng_t *rng)
+{
+    if (c->n++)
+        c->tail->next = node;
+    else
+        c->head = node;
+    c->tail = node;
+    sample_add(c->sample, c->n, node, rng);
+}
+
+static inline long median3(long a, long b, long c)
+{
+    if (a > b) {
+        long t = a;
+        a = b;
+        b = t;
+    }
+    return c < a ? a : c > b ? b : c;
+}
+
+/* Introsort over list nodes
+ *
+ * Each pass splits a segment three ways around the median of three of its
+ * values drawn at random, and writes the result back in place as
+ * [< pivot][== pivot][> pivot]. Runs of equal keys are therefore settled in
+ * one pass, and no input order (sorted, organ pipe, ...) is worse than any
+ * other. The partition draws the samples for the next pivots while it
+ * appends to its output chains, so picking them costs no extra walk.
+ *
+ * The larger side is pushed and the smaller one sorted next, which bounds
+ * the stack by log2(n) entries. A segment that is still being partitioned
+ * 2 * log2(n) levels down is merge sorted instead, so the worst case stays
+ * O(n log n).
+ */
+void quick_sort_intro(struct list_head *list)
+{
+    struct segment stack[64], seg = {.link = &list->next};
+    int top = 0, max_depth = 0;
+    rng_t sampler;
+
+    if (list_empty(list))
+        return;
+    rng_seed(&sampler, 0);
+
+    for (struct list_head *node = list->next; node != list; node = node->next)
+        sample_add(seg.sample, ++seg.n, node, &sampler);
+    for (size_t m = seg.n; m > 1; m >>= 1)
+        max_depth += 2;
+    seg.tail = list->prev;
+    list->prev->next = NULL;
+
+    for (;;) {
+        struct list_head *stop = seg.n ? seg.tail->next : NULL;
+
+        if (seg.n > 1 && seg.depth >= max_depth) {
+            struct list_head *node;
+            seg.tail->next = NULL;
+            *seg.link = node = merge_sort_chain(*seg.link);
+            while (node->next)
+                node = node->next;
+            node->next = stop;
+            seg.n = 0;
+        }
+
+        if (seg.n > 1) {
+            long pivot = list_entry(seg.sample[0], node_t, list)->value;
+            if (seg.n > 2)
+                pivot = median3(pivot,
+                                list_entry(seg.sample[1], node_t, list)->value,
+                                list_entry(seg.sample[2], node_t, list)->value);
+            struct chain lt = {0}, eq = {0}, gt = {0};
+            struct list_head *node = *seg.link;
+
+            for (size_t i = 0; i < seg.n; i++) {
+                struct list_head *next = node->next;
+                long value = list_entry(node, node_t, list)->value;
+                chain_add(value < pivot ? &lt : value > pivot ? &gt : &eq,
+                          node, &sampler);
+                node = next;
+            }
+
+            /* Relink as lt, eq, gt; eq holds the pivot so is never empty. */
+            *seg.link = lt.n ? lt.head : eq.head;
+            if (lt.n)
+                lt.tail->next = eq.head;
+            eq.tail->next = gt.n ? gt.head : stop;
+            if (gt.n)
+                gt.tail->next = stop;
+
+            struct segment l = {seg.link, lt.tail, {0}, lt.n, seg.depth + 1};
+            struct segment r = {&eq.tail->next, gt.tail, {0}, gt.n,
+                                seg.depth + 1};
+            memcpy(l.sample, lt.sample, sizeof(l.sample));
+            memcpy(r.sample, gt.sample, sizeof(r.sample));
+            if (l.n < r.n) {
+                struct segment t = l;
+                l = r;
+                r = t;
+            }
+            if (l.n > 1)
+                stack[top++] = l;
+            seg = r;
+            continue;
+        }
+
+        if (!top)
+            break;
+        seg = stack[--top];
+    }
+
+    rebuild_list_link(list);
+}
+
+static void list_build(struct list_head *list, const int *values, size_t n)
+{
+    INIT_LIST_HEAD(list);
+    while (n--)
+        list_construct(list, values[n]);
+}
+
 int main(int argc, char **argv)
 {
     struct list_head *list = malloc(sizeof(struct list_head));
     INIT_LIST_HEAD(list);
 
-    size_t count = 100000;
+    size_t count = argc > 1 ? strtoul(argv[1], NULL, 0) : 100000;
+    rng_seed(&rng, 1);
     int *test_arr = malloc(sizeof(int) * count);
-    for (int i = 0; i < count; ++i)
+    for (size_t i = 0; i < count; ++i)
         test_arr[i] = i;
     shuffle(test_arr, count);
 
-    while (count--)
-        list_construct(list, test_arr[count]);
-    quick_sort(list);
-    assert(list_is_ordered(list));
-    list_free(list);
+    /* quick_sort() keeps 2 * count pointers on the stack. */
+    if (count && count <= 100000) {
+        list_build(list, test_arr, count);
+        quick_sort(list);
+        assert(list_is_ordered(list));
+        assert((size_t) list_length(list) == count);
+        list_free(list);
+    }
+
+    /* Inputs that send a first-node pivot quadratic */
+    for (int pattern = 0; pattern < 5; pattern++) {
+        for (size_t i = 0; i < count; i++) {
+            switch (pattern) {
+            case 0: /* random */
+                break;
+            case 1: /* sorted */
+                test_arr[i] = i;
+                break;
+            case 2: /* reversed */
+                test_arr[i] = count - i;
+                break;
+            case 3: /* few unique */
+                test_arr[i] = rng_bounded(&rng, 4);
+                break;
+            case 4: /* organ pipe */
+                test_arr[i] = i < count / 2 ? i : count - i;
+                break;
+            }
+        }
+        list_build(list, test_arr, count);
+        quick_sort_intro(list);
+        assert(list_is_ordered(list));
+        assert((size_t) list_length(list) == count);
+        list_free(list);
+    }
+
     free(test_arr);
+    free(list);
     printf("pass test\n");
     return 0;
 }
\ No newline at end of file
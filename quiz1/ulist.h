@@ -0,0 +1,290 @@
+/* Unrolled linked list: cache-line-sized nodes holding runs of values */
+
+#ifndef ULIST_H
+#define ULIST_H
+
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * list_item_t in test1.c spends a node, and so a likely cache miss, on every
+ * int. Here a node is one cache line holding up to ULIST_CAP values in order,
+ * so a traversal touches one line per ULIST_CAP values at best and walks
+ * plain arrays in between.
+ *
+ * A position is a (node, index) pair. Inserting or erasing only moves values
+ * within one node and invalidates the positions into that node and the one
+ * it splits into or merges with. Split and merge relink whole nodes, so they
+ * cost O(ULIST_CAP) however long the lists are.
+ */
+#define ULIST_LINE 64
+#define ULIST_CAP \
+    ((ULIST_LINE - 2 * sizeof(void *) - sizeof(unsigned)) / sizeof(int))
+
+typedef struct ulist_node {
+    struct ulist_node *prev, *next;
+    unsigned count;
+    int values[ULIST_CAP];
+} __attribute__((aligned(ULIST_LINE))) ulist_node_t;
+
+typedef struct {
+    ulist_node_t *head, *tail;
+} ulist_t;
+
+/* A value's place in the list. {NULL, 0} is the end of the list. */
+typedef struct {
+    ulist_node_t *node;
+    unsigned idx;
+} ulist_pos_t;
+
+static inline void ulist_init(ulist_t *l)
+{
+    l->head = l->tail = NULL;
+}
+
+/**
+ * Frees every node of the list and leaves it empty.
+ *
+ * @l : Pointer to the list.
+ */
+static inline void ulist_destroy(ulist_t *l)
+{
+    ulist_node_t *n = l->head;
+    while (n) {
+        ulist_node_t *next = n->next;
+        free(n);
+        n = next;
+    }
+    ulist_init(l);
+}
+
+static inline ulist_pos_t ulist_first(ulist_t *l)
+{
+    return (ulist_pos_t){l->head, 0};
+}
+
+static inline ulist_pos_t ulist_next(ulist_pos_t pos)
+{
+    if (++pos.idx == pos.node->count) {
+        pos.node = pos.node->next;
+        pos.idx = 0;
+    }
+    return pos;
+}
+
+static inline int *ulist_value(ulist_pos_t pos)
+{
+    return &pos.node->values[pos.idx];
+}
+
+/* Walk every value, or every node for array-at-a-time loops. */
+#define ulist_for_each(pos, l) \
+    for ((pos) = ulist_first(l); (pos).node; (pos) = ulist_next(pos))
+#define ulist_for_each_node(n, l) for ((n) = (l)->head; (n); (n) = (n)->next)
+
+static inline size_t ulist_size(ulist_t *l)
+{
+    size_t size = 0;
+    ulist_node_t *n;
+    ulist_for_each_node (n, l)
+        size += n->count;
+    return size;
+}
+
+/* Allocate an empty node and link it after @prev, or first if @prev is
+ * NULL.
+ */
+static inline ulist_node_t *_ulist_node_add(ulist_t *l, ulist_node_t *prev)
+{
+    ulist_node_t *n = aligned_alloc(ULIST_LINE, sizeof(ulist_node_t));
+    if (!n)
+        return NULL;
+
+    n->count = 0;
+    n->prev = prev;
+    n->next = prev ? prev->next : l->head;
+    if (n->next)
+        n->next->prev = n;
+    else
+        l->tail = n;
+    if (prev)
+        prev->next = n;
+    else
+        l->head = n;
+    return n;
+}
+
+static inline void _ulist_node_del(ulist_t *l, ulist_node_t *n)
+{
+    if (n->prev)
+        n->prev->next = n->next;
+    else
+        l->head = n->next;
+    if (n->next)
+        n->next->prev = n->prev;
+    else
+        l->tail = n->prev;
+    free(n);
+}
+
+/* Move the values of @n from @idx on into a new node right after it. */
+static inline ulist_node_t *_ulist_node_split(ulist_t *l,
+                                              ulist_node_t *n,
+                                              unsigned idx)
+{
+    ulist_node_t *m = _ulist_node_add(l, n);
+    if (!m)
+        return NULL;
+
+    m->count = n->count - idx;
+    memcpy(m->values, n->values + idx, m->count * sizeof(int));
+    n->count = idx;
+    return m;
+}
+
+/**
+ * Inserts a value before the given position. A full node is split in two
+ * halves first.
+ *
+ * @l : Pointer to the list.
+ * @pos : The position to insert before, or the end of the list to append.
+ * It is updated to the position of the new value.
+ * @value : The value to insert.
+ * Return 0 on success, -1 if a node could not be allocated.
+ */
+static inline int ulist_insert_before(ulist_t *l, ulist_pos_t *pos, int value)
+{
+    ulist_node_t *n = pos->node;
+    unsigned i = pos->idx;
+
+    if (!n) {
+        n = l->tail;
+        if (!n || n->count == ULIST_CAP)
+            n = _ulist_node_add(l, n);
+        if (!n)
+            return -1;
+        i = n->count;
+    } else if (n->count == ULIST_CAP) {
+        unsigned half = ULIST_CAP / 2;
+        ulist_node_t *m = _ulist_node_split(l, n, half);
+        if (!m)
+            return -1;
+        if (i > half) {
+            n = m;
+            i -= half;
+        }
+    }
+
+    memmove(n->values + i + 1, n->values + i, (n->count - i) * sizeof(int));
+    n->values[i] = value;
+    n->count++;
+    *pos = (ulist_pos_t){n, i};
+    return 0;
+}
+
+static inline int ulist_push_back(ulist_t *l, int value)
+{
+    ulist_pos_t end = {NULL, 0};
+    return ulist_insert_before(l, &end, value);
+}
+
+/**
+ * Removes the value at the given position. A node left less than half full
+ * absorbs its successor if both fit in one node.
+ *
+ * @l : Pointer to the list.
+ * @pos : The position of the value to remove.
+ * Return The position of the value that followed the removed one.
+ */
+static inline ulist_pos_t ulist_erase(ulist_t *l, ulist_pos_t pos)
+{
+    ulist_node_t *n = pos.node, *next = n->next;
+
+    n->count--;
+    memmove(n->values + pos.idx, n->values + pos.idx + 1,
+            (n->count - pos.idx) * sizeof(int));
+
+    if (!n->count) {
+        _ulist_node_del(l, n);
+        return (ulist_pos_t){next, 0};
+    }
+    if (next && n->count < ULIST_CAP / 2 &&
+        n->count + next->count <= ULIST_CAP) {
+        memcpy(n->values + n->count, next->values, next->count * sizeof(int));
+        n->count += next->count;
+        _ulist_node_del(l, next);
+    }
+    if (pos.idx == n->count)
+        return (ulist_pos_t){n->next, 0};
+    return pos;
+}
+
+/**
+ * Cuts a list in two: the values from the given position on move, in order,
+ * to another list. At most one node is split.
+ *
+ * @l : Pointer to the list to split.
+ * @pos : The first position to move. The end of the list moves nothing.
+ * @out : Pointer to the list receiving the tail. Its old content is
+ * overwritten.
+ * Return 0 on success, -1 if a node could not be allocated, in which case
+ * both lists are left as they were.
+ */
+static inline int ulist_split(ulist_t *l, ulist_pos_t pos, ulist_t *out)
+{
+    ulist_node_t *n = pos.node;
+
+    ulist_init(out);
+    if (n && pos.idx == n->count) {
+        n = n->next;
+    } else if (n && pos.idx) {
+        n = _ulist_node_split(l, n, pos.idx);
+        if (!n)
+            return -1;
+    }
+    if (!n)
+        return 0;
+
+    out->head = n;
+    out->tail = l->tail;
+    l->tail = n->prev;
+    if (n->prev)
+        n->prev->next = NULL;
+    else
+        l->head = NULL;
+    n->prev = NULL;
+    return 0;
+}
+
+/**
+ * Appends all values of @src to @dst, leaving @src empty.
+ * The two nodes meeting at the seam are combined if they fit in one.
+ *
+ * @dst : Pointer to the list to append to.
+ * @src : Pointer to the list to append.
+ */
+static inline void ulist_merge(ulist_t *dst, ulist_t *src)
+{
+    ulist_node_t *a = dst->tail, *b = src->head;
+
+    if (!b)
+        return;
+    if (!a) {
+        *dst = *src;
+        ulist_init(src);
+        return;
+    }
+
+    a->next = b;
+    b->prev = a;
+    dst->tail = src->tail;
+    ulist_init(src);
+
+    if (a->count + b->count <= ULIST_CAP) {
+        memcpy(a->values + a->count, b->values, b->count * sizeof(int));
+        a->count += b->count;
+        _ulist_node_del(dst, b);
+    }
+}
+
+#endif /* ULIST_H */
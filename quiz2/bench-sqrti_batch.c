@@ -0,0 +1,97 @@
+/* Throughput of integer square roots over arrays
+ *
+ * Usage: bench-sqrti_batch [elements]
+ *
+ * Roots of random 64-bit values of random width, once for an array that
+ * stays in L1 (4096 elements, repeated) and once for one that streams from
+ * memory (default 1 << 24 elements).
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../common/rng.h"
+#include "sqrti_batch.h"
+
+#define main sqrti_demo_main
+#include "test2.c"
+#undef main
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void loop_sqrti(const uint64_t *in, uint32_t *out, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+        out[i] = sqrti(in[i]);
+}
+
+static void loop_sqrti_tab(const uint64_t *in, uint32_t *out, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+        out[i] = sqrti_tab(in[i]);
+}
+
+typedef struct {
+    const char *name;
+    void (*fn)(const uint64_t *, uint32_t *, size_t);
+} variant_t;
+
+static variant_t variants[6];
+static int nvariants;
+
+static void run(const uint64_t *in, uint32_t *out, size_t n, size_t total)
+{
+    printf("%zu elements:\n", n);
+    for (int v = 0; v < nvariants; v++) {
+        double t0 = now_ns();
+        for (size_t done = 0; done < total; done += n)
+            variants[v].fn(in, out, n);
+        double ns = (now_ns() - t0) / total;
+        printf("  %-22s %7.2f ns/elem %8.1f M/s\n", variants[v].name, ns,
+               1e3 / ns);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    size_t n = argc > 1 ? strtoul(argv[1], NULL, 0) : 1 << 24;
+    uint64_t *in = malloc(n * sizeof(*in));
+    uint32_t *out = malloc(n * sizeof(*out));
+    rng_t r;
+
+    if (!in || !out || n < 4096)
+        return 1;
+    rng_seed(&r, 1);
+    for (size_t i = 0; i < n; i++) {
+        in[i] = rng_next(&r) >> rng_bounded(&r, 64);
+        out[i] = 0;
+    }
+
+    variants[nvariants++] = (variant_t){"sqrti loop", loop_sqrti};
+    variants[nvariants++] = (variant_t){"sqrti_tab loop", loop_sqrti_tab};
+    variants[nvariants++] = (variant_t){"sqrti_batch scalar",
+                                        _sqrti_batch_scalar};
+#ifdef SQRTI_BATCH_SIMD
+    if (__builtin_cpu_supports("avx2"))
+        variants[nvariants++] = (variant_t){"sqrti_batch AVX2",
+                                            _sqrti_batch_avx2};
+    if (__builtin_cpu_supports("avx512f") &&
+        __builtin_cpu_supports("avx512dq"))
+        variants[nvariants++] = (variant_t){"sqrti_batch AVX-512",
+                                            _sqrti_batch_avx512};
+#endif
+
+    run(in, out, 4096, n);
+    run(in, out, n, n);
+
+    free(out);
+    free(in);
+    return 0;
+}
@@ -0,0 +1,155 @@
+/* Integer square roots of whole arrays */
+
+#ifndef SQRTI_BATCH_H
+#define SQRTI_BATCH_H
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * sqrt() on a double gets within one of floor(sqrt(x)) for any 64-bit x:
+ * converting x to double and taking the root each lose at most half an
+ * ulp, which is far below 1 at a root of at most 2^32. Rounding the result
+ * to the nearest integer and comparing its square with x in integer
+ * arithmetic then fixes it exactly:
+ *
+ *   r = min(round(sqrt((double) x)), 2^32 - 1)
+ *   r -= r * r > x
+ *   r += r < 2^32 - 1 && (r + 1) * (r + 1) <= x
+ *
+ * The two corrections never both apply. Squares of r < 2^32 fit in 64 bits.
+ *
+ * On x86-64, sqrti_batch() picks an AVX-512 (F + DQ) or AVX2 loop at run
+ * time; both do the above on 8 or 4 lanes with no branches. Elsewhere, and
+ * for the last few elements, the same steps run one at a time.
+ */
+
+#define SQRTI_BATCH_MAX 0xffffffffULL
+
+static inline uint32_t _sqrti_batch_one(uint64_t x)
+{
+    double d = sqrt((double) x);
+    uint64_t r = d < (double) SQRTI_BATCH_MAX ? (uint64_t) (d + 0.5)
+                                              : SQRTI_BATCH_MAX;
+    r -= r * r > x;
+    r += r < SQRTI_BATCH_MAX && (r + 1) * (r + 1) <= x;
+    return r;
+}
+
+static inline void _sqrti_batch_scalar(const uint64_t *in,
+                                       uint32_t *out,
+                                       size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+        out[i] = _sqrti_batch_one(in[i]);
+}
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+
+#define SQRTI_BATCH_SIMD 1
+
+__attribute__((target("avx2"))) static void
+_sqrti_batch_avx2(const uint64_t *in, uint32_t *out, size_t n)
+{
+    const __m256d two32 = _mm256_set1_pd(4294967296.0);
+    const __m256d max = _mm256_set1_pd((double) SQRTI_BATCH_MAX);
+    /* Adding 2^52 leaves a double's integer part in its low mantissa bits. */
+    const __m256d magic = _mm256_set1_pd(4503599627370496.0);
+    const __m256i sign = _mm256_set1_epi64x(INT64_MIN);
+    const __m256i one = _mm256_set1_epi64x(1);
+    const __m256i rmax = _mm256_set1_epi64x(SQRTI_BATCH_MAX);
+    const __m256i pack = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        __m256i x = _mm256_loadu_si256((const __m256i *) (in + i));
+
+        /* AVX2 has no 64-bit conversion; each 32-bit half is exact. */
+        __m256d hi = _mm256_sub_pd(
+            _mm256_castsi256_pd(_mm256_or_si256(_mm256_srli_epi64(x, 32),
+                                                _mm256_castpd_si256(magic))),
+            magic);
+        __m256d lo = _mm256_sub_pd(
+            _mm256_castsi256_pd(_mm256_or_si256(
+                _mm256_and_si256(x, rmax), _mm256_castpd_si256(magic))),
+            magic);
+        __m256d d = _mm256_sqrt_pd(_mm256_add_pd(_mm256_mul_pd(hi, two32), lo));
+        d = _mm256_add_pd(_mm256_min_pd(d, max), magic);
+        __m256i r = _mm256_xor_si256(_mm256_castpd_si256(d),
+                                     _mm256_castpd_si256(magic));
+
+        /* Unsigned 64-bit compares, through signed ones with flipped tops */
+        __m256i xs = _mm256_xor_si256(x, sign);
+        __m256i sq = _mm256_mul_epu32(r, r);
+        __m256i over = _mm256_cmpgt_epi64(_mm256_xor_si256(sq, sign), xs);
+        __m256i next = _mm256_add_epi64(
+            sq, _mm256_add_epi64(_mm256_add_epi64(r, r), one));
+        __m256i under = _mm256_andnot_si256(
+            _mm256_or_si256(
+                _mm256_cmpgt_epi64(_mm256_xor_si256(next, sign), xs),
+                _mm256_cmpeq_epi64(r, rmax)),
+            _mm256_set1_epi64x(-1));
+        /* over and under are 0 or -1 */
+        r = _mm256_sub_epi64(_mm256_add_epi64(r, over), under);
+
+        r = _mm256_permutevar8x32_epi32(r, pack);
+        _mm_storeu_si128((__m128i *) (out + i), _mm256_castsi256_si128(r));
+    }
+    _sqrti_batch_scalar(in + i, out + i, n - i);
+}
+
+__attribute__((target("avx512f,avx512dq"))) static void
+_sqrti_batch_avx512(const uint64_t *in, uint32_t *out, size_t n)
+{
+    const __m512d max = _mm512_set1_pd((double) SQRTI_BATCH_MAX);
+    const __m512i rmax = _mm512_set1_epi64(SQRTI_BATCH_MAX);
+    const __m512i one = _mm512_set1_epi64(1);
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        __m512i x = _mm512_loadu_si512(in + i);
+        __m512d d = _mm512_sqrt_pd(_mm512_cvtepu64_pd(x));
+        __m512i r = _mm512_cvtpd_epu64(_mm512_min_pd(d, max));
+
+        __m512i sq = _mm512_mul_epu32(r, r);
+        __mmask8 over = _mm512_cmpgt_epu64_mask(sq, x);
+        __m512i next = _mm512_add_epi64(sq, _mm512_add_epi64(
+                                                _mm512_add_epi64(r, r), one));
+        __mmask8 under = _mm512_cmple_epu64_mask(next, x) &
+                         _mm512_cmpneq_epu64_mask(r, rmax);
+        r = _mm512_mask_sub_epi64(r, over, r, one);
+        r = _mm512_mask_add_epi64(r, under, r, one);
+
+        _mm256_storeu_si256((__m256i *) (out + i), _mm512_cvtepi64_epi32(r));
+    }
+    _sqrti_batch_scalar(in + i, out + i, n - i);
+}
+#endif
+
+/**
+ * Computes out[i] = floor(sqrt(in[i])) for i < @n, exactly, for any 64-bit
+ * inputs. @in and @out must not overlap.
+ *
+ * @in : Radicands.
+ * @out : Roots.
+ * @n : Number of elements.
+ */
+static inline void sqrti_batch(const uint64_t *in, uint32_t *out, size_t n)
+{
+#ifdef SQRTI_BATCH_SIMD
+    if (__builtin_cpu_supports("avx512f") &&
+        __builtin_cpu_supports("avx512dq")) {
+        _sqrti_batch_avx512(in, out, n);
+        return;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        _sqrti_batch_avx2(in, out, n);
+        return;
+    }
+#endif
+    _sqrti_batch_scalar(in, out, n);
+}
+
+#endif /* SQRTI_BATCH_H */
@@ -0,0 +1,377 @@
+/* Verification and timing of the square roots in test2.c
+ *
+ * Usage: test-sqrt [threads] [step]
+ *
+ * mysqrtf() is checked on every 32-bit pattern (or every step-th one),
+ * split over the given number of threads (default: all CPUs). Its contract:
+ *
+ *   positive normal   within 1 ulp of sqrtf(); the share that is correctly
+ *                     rounded is reported
+ *   +-0               +-0
+ *   denormal          +-0, flushed to zero
+ *   +inf, +NaN        +inf
+ *   negative, -NaN    -inf
+ *
+ * sqrti(), sqrtiup() and sqrti_tab() are checked on every input below 2^20,
+ * around every power of two and every square near 2^64, and on random
+ * values of every width. icbrt64() is checked around every cube, iroot()
+ * around k^n for every n up to 70, and is_perfect_square() on every input
+ * below 2^22 and around random squares. Timings are in TSC cycles per call
+ * on x86, in nanoseconds elsewhere.
+ */
+
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../common/rng.h"
+#include "sqrti_batch.h"
+
+#define main sqrti_demo_main
+#include "test2.c"
+#undef main
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define TICKS "cycles"
+static inline uint64_t ticks(void)
+{
+    return __rdtsc();
+}
+#else
+#define TICKS "ns"
+static inline uint64_t ticks(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+#endif
+
+static inline float float_of(uint32_t u)
+{
+    float f;
+    memcpy(&f, &u, sizeof(f));
+    return f;
+}
+
+static inline uint32_t bits_of(float f)
+{
+    uint32_t u;
+    memcpy(&u, &f, sizeof(u));
+    return u;
+}
+
+/* What mysqrtf() must return for inputs outside the positive normals */
+static inline int special_case(uint32_t a, uint32_t *expect)
+{
+    uint32_t exp = (a >> 23) & 0xff;
+
+    if (!exp)
+        *expect = a & 0x80000000; /* zero or denormal */
+    else if (a >> 31)
+        *expect = 0xff800000;
+    else if (exp == 0xff)
+        *expect = 0x7f800000;
+    else
+        return 0;
+    return 1;
+}
+
+typedef struct {
+    uint64_t begin, end, step;
+    uint64_t exact, one_ulp, wrong;
+    uint32_t first_wrong;
+    pthread_t tid;
+    int started;
+} sweep_t;
+
+static void *sweep(void *arg)
+{
+    sweep_t *s = arg;
+    /* Counted in registers: the sweep_t of neighbouring threads share cache
+     * lines, and updating them in place every iteration would bounce those
+     * lines between cores.
+     */
+    uint64_t exact = 0, one_ulp = 0, wrong = 0;
+    uint32_t first_wrong = 0;
+
+    for (uint64_t i = s->begin; i < s->end; i += s->step) {
+        uint32_t a = i, got = mysqrtf(a), expect;
+        int ok;
+
+        if (special_case(a, &expect)) {
+            ok = got == expect;
+            exact += ok;
+        } else {
+            expect = bits_of(sqrtf(float_of(a)));
+            ok = got == expect || got == expect + 1 || got == expect - 1;
+            exact += got == expect;
+            one_ulp += ok && got != expect;
+        }
+        if (!ok && !wrong++)
+            first_wrong = a;
+    }
+    s->exact = exact;
+    s->one_ulp = one_ulp;
+    s->wrong = wrong;
+    s->first_wrong = first_wrong;
+    return NULL;
+}
+
+static int check_mysqrtf(int nthreads, uint64_t step)
+{
+    sweep_t *s = calloc(nthreads, sizeof(*s));
+    uint64_t total = 1ULL << 32, exact = 0, one_ulp = 0, wrong = 0;
+    uint64_t t0 = time(NULL);
+
+    if (!s)
+        return 0;
+    /* Slices start on a multiple of @step, so the threads cover the same
+     * patterns as one thread would.
+     */
+    uint64_t per = (total / step + nthreads - 1) / nthreads * step;
+    for (int t = 0; t < nthreads; t++) {
+        s[t].begin = t * per < total ? t * per : total;
+        s[t].end = (t + 1) * per < total ? (t + 1) * per : total;
+        s[t].step = step;
+        s[t].started = !pthread_create(&s[t].tid, NULL, sweep, &s[t]);
+    }
+    for (int t = 0; t < nthreads; t++) {
+        if (s[t].started)
+            pthread_join(s[t].tid, NULL);
+        else
+            sweep(&s[t]);
+        exact += s[t].exact;
+        one_ulp += s[t].one_ulp;
+        if (s[t].wrong && !wrong)
+            printf("  first failure: mysqrtf(0x%08x) = 0x%08x\n",
+                   s[t].first_wrong, mysqrtf(s[t].first_wrong));
+        wrong += s[t].wrong;
+    }
+    printf("mysqrtf: %llu patterns on %d threads in %llu s\n",
+           (unsigned long long) (exact + one_ulp + wrong), nthreads,
+           (unsigned long long) (time(NULL) - t0));
+    printf("  %llu exact, %llu within 1 ulp, %llu wrong\n",
+           (unsigned long long) exact, (unsigned long long) one_ulp,
+           (unsigned long long) wrong);
+    free(s);
+    return !wrong;
+}
+
+/* 0 if @y is floor(sqrt(@x)) (@up: ceil), else 1 */
+static int bad_root(uint64_t x, uint64_t y, int up)
+{
+    __uint128_t yy = (__uint128_t) y * y;
+    __uint128_t below = (__uint128_t) (y - 1) * (y - 1);
+    __uint128_t above = (__uint128_t) (y + 1) * (y + 1);
+
+    if (up)
+        return yy < x || (y && below >= x);
+    return yy > x || above <= x;
+}
+
+static uint64_t checked, failed;
+
+static void check_root64(uint64_t x)
+{
+    uint64_t y = sqrti(x);
+    int bad = bad_root(x, y, 0) | bad_root(x, sqrti_tab(x), 0) |
+              bad_root(x, sqrtiup(x), 1);
+
+    checked++;
+    if (bad && !failed++)
+        printf("  first failure at %llu\n", (unsigned long long) x);
+}
+
+static int check_sqrti64(void)
+{
+    rng_t r;
+
+    for (uint64_t x = 0; x < (1 << 20); x++)
+        check_root64(x);
+    for (int k = 0; k < 64; k++) {
+        for (int64_t d = -2; d <= 2; d++)
+            check_root64((1ULL << k) + d);
+    }
+    /* Squares near 2^64 */
+    for (uint64_t k = 0xffffffffULL; k > 0xffffffffULL - 100000; k--) {
+        check_root64(k * k - 1);
+        check_root64(k * k);
+        check_root64(k * k + 1);
+    }
+    for (uint64_t i = 0; i < 1000; i++)
+        check_root64(UINT64_MAX - i);
+
+    rng_seed(&r, 46);
+    for (int i = 0; i < 10000000; i++) {
+        uint64_t x = rng_next(&r) >> rng_bounded(&r, 64);
+        check_root64(x);
+        uint64_t k = sqrti(x);
+        check_root64(k * k);
+        check_root64(k * k - 1);
+    }
+    printf("sqrti, sqrtiup, sqrti_tab: %llu inputs, %llu wrong\n",
+           (unsigned long long) checked, (unsigned long long) failed);
+    return !failed;
+}
+
+/* y^n in 128 bits, saturated at 2^127 */
+static __uint128_t pow128(uint64_t y, unsigned n)
+{
+    __uint128_t p = 1, cap = (__uint128_t) 1 << 127;
+    while (n--) {
+        if (y && p > cap / y)
+            return cap;
+        p *= y;
+    }
+    return p;
+}
+
+static void check_nth(uint64_t x, unsigned n)
+{
+    uint64_t y = n == 3 ? icbrt64(x) : iroot(x, n);
+    int bad = pow128(y, n) > x || (y < UINT64_MAX && pow128(y + 1, n) <= x);
+
+    checked++;
+    if (bad && !failed++)
+        printf("  first failure: root %u of %llu gave %llu\n", n,
+               (unsigned long long) x, (unsigned long long) y);
+}
+
+static void check_square(uint64_t x)
+{
+    uint64_t y = sqrti(x);
+
+    checked++;
+    if (is_perfect_square(x) != (y * y == x) && !failed++)
+        printf("  first failure: is_perfect_square(%llu)\n",
+               (unsigned long long) x);
+}
+
+static int check_roots(void)
+{
+    rng_t r;
+
+    checked = failed = 0;
+    for (uint64_t x = 0; x < (1 << 20); x++)
+        check_nth(x, 3);
+    /* Every cube that fits, and its neighbours */
+    for (uint64_t k = 1; k <= 2642245; k++) {
+        check_nth(k * k * k - 1, 3);
+        check_nth(k * k * k, 3);
+        check_nth(k * k * k + 1, 3);
+    }
+    for (uint64_t i = 0; i < 1000; i++)
+        check_nth(UINT64_MAX - i, 3);
+
+    rng_seed(&r, 48);
+    for (unsigned n = 1; n <= 70; n++) {
+        uint64_t top = iroot(UINT64_MAX, n);
+        check_nth(UINT64_MAX, n);
+        for (uint64_t k = 1; k <= 1000; k++) {
+            /* Small roots, and the largest ones */
+            uint64_t ks[2] = {k, top >= k ? top - k + 1 : 1};
+            for (int j = 0; j < 2; j++) {
+                __uint128_t p = pow128(ks[j], n);
+                if (p > UINT64_MAX)
+                    continue;
+                uint64_t x = p;
+                check_nth(x - 1, n);
+                check_nth(x, n);
+                if (x < UINT64_MAX)
+                    check_nth(x + 1, n);
+            }
+        }
+        for (int i = 0; i < 100000; i++)
+            check_nth(rng_next(&r) >> rng_bounded(&r, 64), n);
+    }
+
+    for (uint64_t x = 0; x < (1 << 22); x++)
+        check_square(x);
+    for (int i = 0; i < 10000000; i++) {
+        uint64_t k = rng_next(&r) >> (32 + rng_bounded(&r, 32));
+        check_square(k * k);
+        check_square(k * k + 1);
+        check_square(k * k - 1);
+        check_square(rng_next(&r));
+    }
+    printf("icbrt64, iroot, is_perfect_square: %llu inputs, %llu wrong\n",
+           (unsigned long long) checked, (unsigned long long) failed);
+    return !failed;
+}
+
+#define BENCH_N 4096
+#define BENCH_REPS 1000
+
+static uint64_t in64[BENCH_N];
+static uint32_t in32[BENCH_N], out32[BENCH_N];
+static volatile uint64_t sink;
+
+#define TIME_LOOP(name, expr)                                               \
+    do {                                                                    \
+        uint64_t acc = 0, t0 = ticks();                                     \
+        for (int rep = 0; rep < BENCH_REPS; rep++) {                        \
+            for (size_t i = 0; i < BENCH_N; i++)                            \
+                acc += (expr);                                              \
+        }                                                                   \
+        double per = (double) (ticks() - t0) / BENCH_N / BENCH_REPS;        \
+        sink = acc;                                                         \
+        printf("  %-16s %7.2f %s/call\n", name, per, TICKS);               \
+    } while (0)
+
+static void bench(void)
+{
+    rng_t r;
+
+    rng_seed(&r, 47);
+    for (size_t i = 0; i < BENCH_N; i++) {
+        in64[i] = rng_next(&r) >> rng_bounded(&r, 64);
+        /* Positive normal floats */
+        in32[i] = 0x00800000 + rng_bounded(&r, 0x7f000000);
+    }
+
+    printf("Timing, random inputs:\n");
+    TIME_LOOP("sqrti", sqrti(in64[i]));
+    TIME_LOOP("sqrtiup", sqrtiup(in64[i]));
+    TIME_LOOP("sqrti_tab", sqrti_tab(in64[i]));
+    TIME_LOOP("mysqrtf", mysqrtf(in32[i]));
+    TIME_LOOP("sqrtf (libm)", bits_of(sqrtf(float_of(in32[i]))));
+    TIME_LOOP("icbrt64", icbrt64(in64[i]));
+    TIME_LOOP("iroot(x, 5)", iroot(in64[i], 5));
+    TIME_LOOP("iroot(x, 17)", iroot(in64[i], 17));
+    TIME_LOOP("square by root", sqrti_tab(in64[i]) * (uint64_t) sqrti_tab(
+                                    in64[i]) == in64[i]);
+    TIME_LOOP("is_perfect_square", is_perfect_square(in64[i]));
+
+    uint64_t t0 = ticks();
+    for (int rep = 0; rep < BENCH_REPS; rep++)
+        sqrti_batch(in64, out32, BENCH_N);
+    printf("  %-16s %7.2f %s/call\n", "sqrti_batch",
+           (double) (ticks() - t0) / BENCH_N / BENCH_REPS, TICKS);
+}
+
+int main(int argc, char **argv)
+{
+    int nthreads = argc > 1 ? atoi(argv[1]) : sysconf(_SC_NPROCESSORS_ONLN);
+    uint64_t step = argc > 2 ? strtoull(argv[2], NULL, 0) : 1;
+    int ok;
+
+    if (nthreads < 1)
+        nthreads = 1;
+    if (step < 1)
+        step = 1;
+
+    ok = check_sqrti64();
+    ok &= check_roots();
+    ok &= check_mysqrtf(nthreads, step);
+    bench();
+
+    printf(ok ? "ALL TESTS PASSED\n" : "TESTS FAILED\n");
+    return !ok;
+}
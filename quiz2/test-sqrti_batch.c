@@ -0,0 +1,164 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../common/rng.h"
+#include "sqrti_batch.h"
+
+/* sqrti() and friends, with the demo main() out of the way */
+#define main sqrti_demo_main
+#include "test2.c"
+#undef main
+
+#define my_assert(test, message) \
+    do {                         \
+        if (!(test))             \
+            return message;      \
+    } while (0)
+#define my_run_test(test)       \
+    do {                        \
+        char *message = test(); \
+        tests_run++;            \
+        if (message)            \
+            return message;     \
+    } while (0)
+
+#define CHUNK 4096
+
+typedef void (*batch_fn)(const uint64_t *, uint32_t *, size_t);
+
+typedef struct {
+    const char *name;
+    batch_fn fn;
+} path_t;
+
+static path_t paths[3];
+static int npaths;
+
+static uint64_t in[CHUNK];
+static uint32_t out[CHUNK + 1];
+static const char *failed;
+static uint64_t failed_at;
+
+/* Run every path on in[0 .. n) and compare with sqrti(). */
+static int check(size_t n)
+{
+    for (int p = 0; p < npaths; p++) {
+        out[n] = 0xdeadbeef;
+        paths[p].fn(in, out, n);
+        if (out[n] != 0xdeadbeef) {
+            failed = paths[p].name;
+            failed_at = n;
+            return 0;
+        }
+        for (size_t i = 0; i < n; i++) {
+            if (out[i] != sqrti(in[i])) {
+                failed = paths[p].name;
+                failed_at = in[i];
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+static char *report(void)
+{
+    static char msg[128];
+    snprintf(msg, sizeof(msg), "%s path wrong at %llu", failed,
+             (unsigned long long) failed_at);
+    return msg;
+}
+
+static char *test_small(void)
+{
+    /* Every input below 2^24 */
+    for (uint64_t base = 0; base < (1 << 24); base += CHUNK) {
+        for (size_t i = 0; i < CHUNK; i++)
+            in[i] = base + i;
+        if (!check(CHUNK))
+            return report();
+    }
+    return NULL;
+}
+
+static char *test_squares(void)
+{
+    rng_t r;
+    size_t n = 0;
+
+    /* k^2 - 1, k^2 and k^2 + 1: for every k within 2^20 of 2^32, and for
+     * 2^22 random k of every width.
+     */
+    rng_seed(&r, 44);
+    for (uint64_t j = 0; j < (1 << 20) + (1 << 22); j++) {
+        uint64_t k = j < (1 << 20) ? SQRTI_BATCH_MAX - j
+                                   : rng_next(&r) >> (32 + rng_bounded(&r, 32));
+        in[n++] = k * k - 1;
+        in[n++] = k * k;
+        in[n++] = k * k + 1;
+        if (n + 3 > CHUNK) {
+            if (!check(n))
+                return report();
+            n = 0;
+        }
+    }
+    /* The top of the range, where (double) x rounds up to 2^64 */
+    for (size_t i = 0; i < CHUNK; i++)
+        in[i] = UINT64_MAX - i;
+    return check(CHUNK) ? NULL : report();
+}
+
+static char *test_random(void)
+{
+    rng_t r;
+
+    rng_seed(&r, 45);
+    for (int round = 0; round < 4096; round++) {
+        for (size_t i = 0; i < CHUNK; i++)
+            in[i] = rng_next(&r) >> rng_bounded(&r, 64);
+        if (!check(CHUNK))
+            return report();
+    }
+
+    /* Every length up to a few vectors, for the scalar tails */
+    for (size_t n = 0; n <= 40; n++) {
+        if (!check(n))
+            return report();
+    }
+    return NULL;
+}
+
+int tests_run = 0;
+
+static char *test_suite(void)
+{
+    my_run_test(test_small);
+    my_run_test(test_squares);
+    my_run_test(test_random);
+    return NULL;
+}
+
+int main(void)
+{
+    paths[npaths++] = (path_t){"scalar", _sqrti_batch_scalar};
+#ifdef SQRTI_BATCH_SIMD
+    if (__builtin_cpu_supports("avx2"))
+        paths[npaths++] = (path_t){"AVX2", _sqrti_batch_avx2};
+    if (__builtin_cpu_supports("avx512f") &&
+        __builtin_cpu_supports("avx512dq"))
+        paths[npaths++] = (path_t){"AVX-512", _sqrti_batch_avx512};
+#endif
+
+    printf("---=[ sqrti_batch tests (");
+    for (int p = 0; p < npaths; p++)
+        printf("%s%s", p ? ", " : "", paths[p].name);
+    printf(")\n");
+    char *result = test_suite();
+    if (result)
+        printf("ERROR: %s\n", result);
+    else
+        printf("ALL TESTS PASSED\n");
+    printf("Tests run: %d\n", tests_run);
+    return !!result;
+}
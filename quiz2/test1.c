@@ -3,6 +3,7 @@
 #include <stdlib.h>
 #include <assert.h>
 
+#include "../common/rng.h"
 #include "list.h"
 
 struct listitem {
@@ -49,49 +50,155 @@ static void list_quicksort(struct list_head *head)
     list_splice_tail(&list_greater, head);
 }
 
-#define ARRAY_SIZE(x) (sizeof(x) / sizeof(x[0]))
+/* Median of three entries of @head drawn at random; @n >= 2 is its length.
+ * The three positions are sorted first so that one walk reaches them all.
+ */
+static struct listitem *random_pivot(struct list_head *head,
+                                     size_t n,
+                                     rng_t *r)
+{
+    size_t pos[3], at = 0;
+    struct listitem *pick[3];
+    struct list_head *node = head->next;
 
-static uint16_t values[256];
+    for (int k = 0; k < 3; k++) {
+        size_t p = rng_bounded(r, n), j = k;
+        for (; j && pos[j - 1] > p; j--)
+            pos[j] = pos[j - 1];
+        pos[j] = p;
+    }
+    for (int k = 0; k < 3; k++) {
+        for (; at < pos[k]; at++)
+            node = node->next;
+        pick[k] = list_entry(node, struct listitem, list);
+    }
 
-static inline uint8_t getnum(void)
+    struct listitem *a = pick[0], *b = pick[1], *c = pick[2];
+    if (cmpint(&a->i, &b->i) > 0) {
+        struct listitem *t = a;
+        a = b;
+        b = t;
+    }
+    /* Now a <= b; if c is below b the median is the larger of a and c */
+    if (cmpint(&b->i, &c->i) > 0)
+        b = cmpint(&a->i, &c->i) > 0 ? a : c;
+    return b;
+}
+
+static void list_quicksort3_n(struct list_head *head, size_t n, rng_t *r)
 {
-    static uint16_t s1 = UINT16_C(2);
-    static uint16_t s2 = UINT16_C(1);
-    static uint16_t s3 = UINT16_C(1);
+    struct list_head lo, hi;
 
-    s1 *= UINT16_C(171);
-    s1 %= UINT16_C(30269);
+    INIT_LIST_HEAD(&lo);
+    INIT_LIST_HEAD(&hi);
 
-    s2 *= UINT16_C(172);
-    s2 %= UINT16_C(30307);
+    while (n > 1) {
+        struct list_head list_less, list_equal, list_greater;
+        struct listitem *pivot, *item = NULL, *is = NULL;
+        size_t n_less = 0, n_greater = 0;
 
-    s3 *= UINT16_C(170);
-    s3 %= UINT16_C(30323);
+        INIT_LIST_HEAD(&list_less);
+        INIT_LIST_HEAD(&list_equal);
+        INIT_LIST_HEAD(&list_greater);
 
-    return s1 ^ s2 ^ s3;
+        pivot = random_pivot(head, n, r);
+        list_move_tail(&pivot->list, &list_equal);
+
+        list_for_each_entry_safe (item, is, head, list) {
+            int c = cmpint(&item->i, &pivot->i);
+            if (c < 0) {
+                list_move_tail(&item->list, &list_less);
+                n_less++;
+            } else if (c > 0) {
+                list_move_tail(&item->list, &list_greater);
+                n_greater++;
+            } else {
+                list_move_tail(&item->list, &list_equal);
+            }
+        }
+
+        if (n_less <= n_greater) {
+            list_quicksort3_n(&list_less, n_less, r);
+            list_splice_tail(&list_less, &lo);
+            list_splice_tail(&list_equal, &lo);
+            list_splice(&list_greater, head);
+            n = n_greater;
+        } else {
+            list_quicksort3_n(&list_greater, n_greater, r);
+            list_splice(&list_greater, &hi);
+            list_splice(&list_equal, &hi);
+            list_splice(&list_less, head);
+            n = n_less;
+        }
+    }
+
+    list_splice(&lo, head);
+    list_splice_tail(&hi, head);
 }
 
-static uint16_t get_unsigned16(void)
+/* Same partitioning, split three ways, with O(log n) stack
+ *
+ * The pivot is the median of three entries drawn at random, as in
+ * quick_sort_intro(), so no input order (sorted, reversed, organ pipe, ...)
+ * is worse than any other and the expected time is O(n log n) on all of
+ * them. Keys equal to the pivot are set aside instead of going to
+ * list_greater, so duplicates cost one pass. Only the smaller side is sorted
+ * by a recursive call; the larger one becomes the next round of the loop, so
+ * every nested call handles at most half of its caller's nodes. Sides that
+ * are finished are collected in @lo (everything before the part still being
+ * sorted) and @hi (everything after it).
+ */
+static void list_quicksort3(struct list_head *head)
 {
-    uint16_t x = 0;
-    size_t i;
+    struct list_head *node;
+    size_t n = 0;
+    rng_t r;
 
-    for (i = 0; i < sizeof(x); i++) {
-        x <<= 8;
-        x |= getnum();
-    }
+    list_for_each (node, head)
+        n++;
+    rng_seed(&r, 0);
+    list_quicksort3_n(head, n, &r);
+}
+
+#define ARRAY_SIZE(x) (sizeof(x) / sizeof(x[0]))
+
+static uint16_t values[256];
 
-    return x;
+static rng_t rng;
+
+/* Fill @a with a random permutation of 0 .. @len - 1. */
+static void random_permutation(uint16_t *a, size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+        a[i] = i;
+    rng_shuffle(&rng, a, len, sizeof(a[0]));
 }
 
-static inline void random_shuffle_array(uint16_t *operations, uint16_t len)
+/* Sort @n keys with list_quicksort3() and compare against qsort(). */
+static void check_quicksort3(uint16_t *keys, size_t n)
 {
-    for (uint16_t i = 0; i < len; i++) {
-        /* WARNING biased shuffling */
-        uint16_t j = get_unsigned16() % (i + 1);
-        operations[i] = operations[j];
-        operations[j] = i;
+    struct list_head testlist;
+    struct listitem *item, *is = NULL;
+    struct listitem *items = malloc(n * sizeof(*items));
+    size_t i;
+
+    assert(items);
+    INIT_LIST_HEAD(&testlist);
+    for (i = 0; i < n; i++) {
+        items[i].i = keys[i];
+        list_add_tail(&items[i].list, &testlist);
     }
+
+    qsort(keys, n, sizeof(keys[0]), cmpint);
+    list_quicksort3(&testlist);
+
+    i = 0;
+    list_for_each_entry_safe (item, is, &testlist, list) {
+        assert(item->i == keys[i]);
+        i++;
+    }
+    assert(i == n);
+    free(items);
 }
 
 int main(void)
@@ -100,7 +207,8 @@ int main(void)
     struct listitem *item, *is = NULL;
     size_t i;
 
-    random_shuffle_array(values, (uint16_t) ARRAY_SIZE(values));
+    rng_seed(&rng, 1);
+    random_permutation(values, ARRAY_SIZE(values));
 
     INIT_LIST_HEAD(&testlist);
 
@@ -128,6 +236,34 @@ int main(void)
 
     assert(i == ARRAY_SIZE(values));
     assert(list_empty(&testlist));
+
+    /* The same values, then inputs that recurse list_quicksort() n deep */
+    random_permutation(values, ARRAY_SIZE(values));
+    check_quicksort3(values, ARRAY_SIZE(values));
+
+    size_t n = 1000000;
+    uint16_t *keys = malloc(n * sizeof(*keys));
+    assert(keys);
+    for (i = 0; i < n; i++)
+        keys[i] = 42;
+    check_quicksort3(keys, n);
+    for (i = 0; i < n; i++)
+        keys[i] = rng_bounded(&rng, 4);
+    check_quicksort3(keys, n);
+    /* Sorted, reversed and organ-pipe input, each quadratic with some
+     * fixed choice of pivot
+     */
+    for (i = 0; i < n; i++)
+        keys[i] = i * 65536 / n;
+    check_quicksort3(keys, n);
+    for (i = 0; i < n; i++)
+        keys[i] = 65535 - i * 65536 / n;
+    check_quicksort3(keys, n);
+    for (i = 0; i < n; i++)
+        keys[i] = (i < n / 2 ? i : n - 1 - i) * 65536 / n;
+    check_quicksort3(keys, n);
+    free(keys);
+
     printf("pass test\n");
     return 0;
 }
\ No newline at end of file
@@ -2,29 +2,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 
-#define clz32(x) clz2(x, 0)
-
-static const int mask[] = {0, 8, 12, 14};
-static const int magic[] = {1, 1, 0, 0};
-
-unsigned clz2(uint32_t x, int c)
-{
-    if (!x && !c)
-        return 32;
-    uint32_t upper = (x >> (16 >> c));
-    uint32_t lower = (x & (0xFFFF >> mask[c]));
-    if (c == 3)
-        return upper ? magic[upper] : 2 + magic[lower];
-    return upper ? clz2(upper, c + 1) : (16 >> (c)) + clz2(lower, c + 1);
-}
-
-static inline int clz64(uint64_t x)
-{
-    /* If the high 32 bits are nonzero, count within them.
-     * Otherwise, count in the low 32 bits and add 32.
-     */
-    return (x >> 32) ? clz32((uint32_t) (x >> 32)) : clz32((uint32_t) x) + 32;
-}
+#include "../common/bitops.h"
 
 uint64_t sqrti(uint64_t x)
 {
@@ -44,11 +22,13 @@ uint64_t sqrti(uint64_t x)
 
     while (m) {
         uint64_t b = y + m;
+        /* All ones if x >= b; a mask instead of a branch that mispredicts
+         * half the time.
+         */
+        uint64_t take = -(uint64_t) (x >= b);
         y >>= 1;
-        if (x >= b) {
-            x -= b;
-            y += m;
-        }
+        x -= b & take;
+        y += m & take;
         m >>= 2;
     }
     return y;
@@ -109,17 +89,99 @@ uint64_t sqrtiup(uint64_t x)
 
     while (m) {
         uint64_t b = y + m;
+        /* All ones if x >= b; a mask instead of a branch that mispredicts
+         * half the time.
+         */
+        uint64_t take = -(uint64_t) (x >= b);
         y >>= 1;
-        if (x >= b) {
-            x -= b;
-            y += m;
-        }
+        x -= b & take;
+        y += m & take;
         m >>= 2;
     }
     y += (x > 0);
     return y;
 }
 
+// integer cube root of a 64-bit unsigned integer
+uint32_t icbrt64(uint64_t x)
+{
+    uint64_t y = 0;
+    if (!x)
+        return 0;
+
+    /* One result bit per 3 input bits, from the highest group that holds a
+     * set bit. (y + 1)^3 - y^3 = 3y(y + 1) + 1 is what adding the bit costs.
+     */
+    for (int s = (63 - clz64(x)) / 3 * 3; s >= 0; s -= 3) {
+        y <<= 1;
+        uint64_t b = 3 * y * (y + 1) + 1;
+        uint64_t take = -(uint64_t) ((x >> s) >= b);
+        x -= (b << s) & take;
+        y -= take;
+    }
+    return y;
+}
+
+/* y^k, or UINT64_MAX if that does not fit */
+static uint64_t ipow_sat(uint64_t y, unsigned k)
+{
+    uint64_t p = 1;
+    while (k--) {
+        if (__builtin_mul_overflow(p, y, &p))
+            return UINT64_MAX;
+    }
+    return p;
+}
+
+// integer n-th root: floor(x^(1/n)), for n >= 1
+uint64_t iroot(uint64_t x, unsigned n)
+{
+    if (n <= 1 || x <= 1)
+        return x;
+    if (n == 2)
+        return sqrti_tab(x);
+    if (n == 3)
+        return icbrt64(x);
+    if (n >= 64)
+        return 1;
+
+    /* Newton's method from above: 2^ceil(bits / n) exceeds the root, and
+     * every step lands between the root and the previous guess until it
+     * stops decreasing. A saturated power only overestimates x / y^(n-1)
+     * by 1 while y is still far too large, which keeps that true.
+     */
+    int bits = 64 - clz64(x);
+    uint64_t y = 1ULL << ((bits + n - 1) / n);
+    for (;;) {
+        uint64_t next = ((n - 1) * y + x / ipow_sat(y, n - 1)) / n;
+        if (next >= y)
+            return y;
+        y = next;
+    }
+}
+
+/* Nonzero if x is a perfect square. Squares fall on 12 of the 64 residues
+ * mod 64, 16 of 63, 21 of 65 and 6 of 11, so the bitmasks turn away all but
+ * about 0.8% of random inputs before a root is taken.
+ */
+int is_perfect_square(uint64_t x)
+{
+    static const uint64_t qr64 = 0x0202021202030213ULL;
+    static const uint64_t qr63 = 0x0402483012450293ULL;
+    static const uint64_t qr65 = 0x218a019866014613ULL; /* and 64 */
+    static const uint64_t qr11 = 0x23b;
+
+    if (!((qr64 >> (x & 63)) & 1))
+        return 0;
+    uint32_t r = x % (63 * 65 * 11), r65 = r % 65;
+    if (!((qr63 >> (r % 63)) & 1) || !(r65 == 64 || ((qr65 >> r65) & 1)) ||
+        !((qr11 >> (r % 11)) & 1))
+        return 0;
+
+    uint64_t y = sqrti_tab(x);
+    return y * y == x;
+}
+
 uint32_t mysqrtf(uint32_t a0)
 {
     uint32_t a1, a2, a3, a4;
@@ -127,7 +189,7 @@ uint32_t mysqrtf(uint32_t a0)
         0xf1, 0xda, 0xc9, 0xbb, 0xb0, 0xa6, 0x9e, 0x97, 0x91, 0x8b, 0x86, 0x82
     };
 
-    if (a0 < 0) {
+    if ((int32_t) a0 < 0) {
         a1 = a0 << 1;
         a1 >>= 24;
         if (a1) {
@@ -157,7 +219,7 @@ uint32_t mysqrtf(uint32_t a0)
                 if (a4)
                     a1 <<= 1;
                 a3 = a1 >> 21;
-                a4 = rsqrt_lut[a3];
+                a4 = rsqrt_lut[a3 - 4];
                 
                 a0 = a1 >> 7;
                 a0 *= a4;
@@ -216,7 +278,7 @@ uint32_t mysqrtf(uint32_t a0)
                     a4 *= a4;
                     a1 <<= 16;
                     a1 -= a4;
-                    if (a1 >= 0)
+                    if ((int32_t) a1 >= 0)
                         a3++;
                 }
                 a2 <<=  23;
@@ -0,0 +1,165 @@
+/* Line ingestion: stdio against mapped, zero-copy slices
+ *
+ * Usage: bench-lines [bytes] [threads]
+ *
+ * Writes a log of random lines, 20 to 180 bytes long, to a scratch file
+ * (default 256 MiB) and reads it back line by line: with fgets() into a
+ * buffer, with getline(), with line_iter_next() over the mapping, and with
+ * lines_parallel() (default one thread per CPU). Every reader counts lines
+ * and bytes, and the file is read once beforehand so that it is in the page
+ * cache for all of them.
+ */
+
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../common/rng.h"
+#include "lines.h"
+
+static double now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec * 1e-6;
+}
+
+typedef struct {
+    size_t lines, bytes;
+    char pad[48]; /* One cache line each for lines_parallel() */
+} tally_t;
+
+static const char *path;
+
+static tally_t read_fgets(void)
+{
+    tally_t t = {0};
+    char buf[4096];
+    FILE *f = fopen(path, "r");
+
+    while (f && fgets(buf, sizeof(buf), f)) {
+        size_t len = strlen(buf);
+        t.lines += len && buf[len - 1] == '\n';
+        t.bytes += len - (len && buf[len - 1] == '\n');
+    }
+    if (f)
+        fclose(f);
+    return t;
+}
+
+static tally_t read_getline(void)
+{
+    tally_t t = {0};
+    char *buf = NULL;
+    size_t cap = 0;
+    ssize_t len;
+    FILE *f = fopen(path, "r");
+
+    while (f && (len = getline(&buf, &cap, f)) > 0) {
+        t.lines++;
+        t.bytes += len - (buf[len - 1] == '\n');
+    }
+    free(buf);
+    if (f)
+        fclose(f);
+    return t;
+}
+
+static void count(const char *buf, size_t len, int part, void *arg)
+{
+    tally_t *t = (tally_t *) arg + part;
+    line_iter_t it;
+    line_t line;
+
+    line_iter_init(&it, buf, len);
+    while (line_iter_next(&it, &line)) {
+        t->lines++;
+        t->bytes += line.len;
+    }
+}
+
+static tally_t read_mapped(void)
+{
+    tally_t t = {0};
+    mapped_file_t f;
+
+    if (!mapped_file_open(&f, path)) {
+        count(f.data, f.size, 0, &t);
+        mapped_file_close(&f);
+    }
+    return t;
+}
+
+static int nthreads;
+
+static tally_t read_parallel(void)
+{
+    tally_t t = {0}, parts[LINES_MAX_THREADS];
+    mapped_file_t f;
+
+    memset(parts, 0, sizeof(parts));
+    if (!mapped_file_open(&f, path)) {
+        lines_parallel(f.data, f.size, nthreads, count, parts);
+        mapped_file_close(&f);
+    }
+    for (int i = 0; i < LINES_MAX_THREADS; i++) {
+        t.lines += parts[i].lines;
+        t.bytes += parts[i].bytes;
+    }
+    return t;
+}
+
+int main(int argc, char **argv)
+{
+    size_t n = argc > 1 ? strtoul(argv[1], NULL, 0) : 256 << 20;
+    static char name[] = "/tmp/bench-lines.XXXXXX";
+    static const struct {
+        const char *name;
+        tally_t (*fn)(void);
+    } readers[] = {
+        {"fgets", read_fgets},
+        {"getline", read_getline},
+        {"mapped", read_mapped},
+        {"mapped, parallel", read_parallel},
+    };
+    char *buf = malloc(n);
+    rng_t r;
+    int fd;
+
+    nthreads = argc > 2 ? atoi(argv[2]) : sysconf(_SC_NPROCESSORS_ONLN);
+    if (!buf || (fd = mkstemp(name)) < 0)
+        return 1;
+    path = name;
+
+    rng_seed(&r, 1);
+    for (size_t i = 0, eol = 20; i < n; i++) {
+        if (i == eol) {
+            buf[i] = '\n';
+            eol = i + 21 + rng_bounded(&r, 160);
+        } else {
+            buf[i] = ' ' + rng_bounded(&r, 95);
+        }
+    }
+    buf[n - 1] = '\n';
+    if (write(fd, buf, n) != (ssize_t) n)
+        return 1;
+    close(fd);
+    free(buf);
+    read_mapped();
+
+    printf("%zu MiB, %d threads for parallel\n", n >> 20, nthreads);
+    for (size_t i = 0; i < sizeof(readers) / sizeof(readers[0]); i++) {
+        double t0 = now_ms();
+        tally_t t = readers[i].fn();
+        double ms = now_ms() - t0;
+        printf("  %-18s %8.1f ms %8.0f MB/s %6.2f ns/line (%zu lines)\n",
+               readers[i].name, ms, n / ms * 1e-3, ms * 1e6 / t.lines,
+               t.lines);
+    }
+    unlink(name);
+    return 0;
+}
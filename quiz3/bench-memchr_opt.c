@@ -0,0 +1,187 @@
+/* Byte search throughput against glibc
+ *
+ * Usage: bench-memchr_opt [bytes]
+ *
+ * Scans buffers of growing size (up to 64 MiB by default) for a byte that
+ * is not there, which measures the bulk loops, then splits a synthetic log
+ * of that size into lines and fields, which measures the short searches a
+ * log scanner makes between delimiters.
+ */
+
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../common/rng.h"
+#include "memchr_opt.h"
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+#ifdef MEMCHR_OPT_SIMD
+static void *sse2_chr(const void *s, int c, size_t n)
+{
+    return n ? (void *) _memchr_fwd_sse2(s, n, 1, c, c, c) : NULL;
+}
+
+static void *avx2_chr(const void *s, int c, size_t n)
+{
+    return n ? (void *) _memchr_fwd_avx2(s, n, 1, c, c, c) : NULL;
+}
+
+static void *sse2_rchr(const void *s, int c, size_t n)
+{
+    return n ? (void *) _memrchr_sse2(s, n, c) : NULL;
+}
+
+static void *avx2_rchr(const void *s, int c, size_t n)
+{
+    return n ? (void *) _memrchr_avx2(s, n, c) : NULL;
+}
+#endif
+
+static void *glibc_chr(const void *s, int c, size_t n)
+{
+    return memchr(s, c, n);
+}
+
+static void *glibc_rchr(const void *s, int c, size_t n)
+{
+    return memrchr(s, c, n);
+}
+
+/* What memchr3_opt() replaces */
+static void *bytes_chr3(const void *str, int c1, int c2, int c3, size_t n)
+{
+    const unsigned char *s = str;
+    for (size_t i = 0; i < n; i++) {
+        if (s[i] == c1 || s[i] == c2 || s[i] == c3)
+            return (void *) (s + i);
+    }
+    return NULL;
+}
+
+static void *opt_chr3(const void *s, int c1, int c2, int c3, size_t n)
+{
+    return memchr3_opt(s, c1, c2, c3, n);
+}
+
+typedef struct {
+    const char *name;
+    void *(*fn)(const void *, int, size_t);
+} variant_t;
+
+static variant_t variants[12];
+static int nvariants;
+static volatile uintptr_t sink;
+
+static void bulk(const unsigned char *buf, size_t max)
+{
+    printf("%-18s", "absent byte, GB/s");
+    for (size_t n = 64; n <= max; n *= 16)
+        printf(" %9zu", n);
+    printf("\n");
+    for (int v = 0; v < nvariants; v++) {
+        printf("  %-16s", variants[v].name);
+        for (size_t n = 64; n <= max; n *= 16) {
+            /* Enough calls for about 256 MiB, and never fewer than 4 */
+            size_t reps = (256 << 20) / n + 4;
+            double t0 = now_ns();
+            for (size_t r = 0; r < reps; r++)
+                sink += (uintptr_t) variants[v].fn(buf + (r & 7), 0, n);
+            printf(" %9.2f", (double) n * reps / (now_ns() - t0));
+        }
+        printf("\n");
+    }
+}
+
+static void lines(const unsigned char *log, size_t n)
+{
+    printf("log of %zu bytes, ns per line\n", n);
+    for (int v = 0; v < nvariants; v++) {
+        /* The reverse searches have no place here */
+        if (strstr(variants[v].name, "memrchr"))
+            continue;
+        size_t count = 0;
+        double t0 = now_ns();
+        for (const unsigned char *p = log, *end = log + n, *nl;
+             (nl = variants[v].fn(p, '\n', end - p)); p = nl + 1)
+            count++;
+        printf("  %-16s %7.2f (%zu lines)\n", variants[v].name,
+               (now_ns() - t0) / count, count);
+    }
+}
+
+static void fields(const unsigned char *log, size_t n)
+{
+    static const struct {
+        const char *name;
+        void *(*fn)(const void *, int, int, int, size_t);
+    } f[] = {{"byte loop", bytes_chr3}, {"memchr3_opt", opt_chr3}};
+
+    printf("log of %zu bytes, ns per field (\\n , \")\n", n);
+    for (size_t v = 0; v < sizeof(f) / sizeof(f[0]); v++) {
+        size_t count = 0;
+        double t0 = now_ns();
+        for (const unsigned char *p = log, *end = log + n, *d;
+             (d = f[v].fn(p, '\n', ',', '"', end - p)); p = d + 1)
+            count++;
+        printf("  %-16s %7.2f (%zu fields)\n", f[v].name,
+               (now_ns() - t0) / count, count);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    size_t n = argc > 1 ? strtoul(argv[1], NULL, 0) : 64 << 20;
+    unsigned char *buf = malloc(n + 8);
+    rng_t r;
+
+    if (!buf || n < 64)
+        return 1;
+
+    variants[nvariants++] = (variant_t){"glibc memchr", glibc_chr};
+    variants[nvariants++] = (variant_t){"word", _memchr_swar};
+#ifdef MEMCHR_OPT_SIMD
+    variants[nvariants++] = (variant_t){"SSE2", sse2_chr};
+    if (__builtin_cpu_supports("avx2"))
+        variants[nvariants++] = (variant_t){"AVX2", avx2_chr};
+#endif
+    variants[nvariants++] = (variant_t){"memchr_opt", memchr_opt};
+    variants[nvariants++] = (variant_t){"glibc memrchr", glibc_rchr};
+#ifdef MEMCHR_OPT_SIMD
+    variants[nvariants++] = (variant_t){"SSE2 memrchr", sse2_rchr};
+    if (__builtin_cpu_supports("avx2"))
+        variants[nvariants++] = (variant_t){"AVX2 memrchr", avx2_rchr};
+#endif
+    variants[nvariants++] = (variant_t){"memrchr_opt", memrchr_opt};
+
+    memset(buf, 'x', n + 8);
+    bulk(buf, n);
+
+    /* Lines of 20 to 180 bytes with a comma-separated field every 12 or
+     * so, and now and then a quoted one.
+     */
+    rng_seed(&r, 1);
+    for (size_t i = 0, eol = 0; i < n; i++) {
+        if (i == eol) {
+            buf[i] = '\n';
+            eol = i + 20 + rng_bounded(&r, 160);
+            continue;
+        }
+        uint32_t x = rng_bounded(&r, 256);
+        buf[i] = x < 20 ? ',' : x < 22 ? '"' : 'a' + x % 26;
+    }
+    lines(buf, n);
+    fields(buf, n);
+
+    free(buf);
+    return 0;
+}
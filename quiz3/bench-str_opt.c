@@ -0,0 +1,146 @@
+/* String scans against glibc, short strings first
+ *
+ * Usage: bench-str_opt
+ *
+ * For each range of lengths, 4096 strings (fewer when long) of random
+ * length within it are placed at random offsets, and each function is
+ * called on all of them in turn: ns per call, and GB/s over the bytes
+ * scanned. strchr looks for a byte the strings do not contain, so it scans
+ * as far as strlen.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../common/rng.h"
+#include "str_opt.h"
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static size_t glibc_strlen(const char *s)
+{
+    return strlen(s);
+}
+
+static size_t glibc_strchr(const char *s)
+{
+    return (uintptr_t) strchr(s, ',');
+}
+
+static size_t glibc_strnlen(const char *s)
+{
+    return strnlen(s, 1 << 21);
+}
+
+static size_t opt_strlen(const char *s)
+{
+    return strlen_opt(s);
+}
+
+static size_t opt_strchr(const char *s)
+{
+    return (uintptr_t) strchr_opt(s, ',');
+}
+
+static size_t opt_strnlen(const char *s)
+{
+    return strnlen_opt(s, 1 << 21);
+}
+
+static size_t word_strlen(const char *s)
+{
+    return _strchrnul_swar(s, 0) - s;
+}
+
+#ifdef MEMCHR_OPT_SIMD
+static size_t sse2_strlen(const char *s)
+{
+    return _strchrnul_sse2(s, 0) - s;
+}
+
+static size_t avx2_strlen(const char *s)
+{
+    return _strchrnul_avx2(s, 0) - s;
+}
+#endif
+
+typedef struct {
+    const char *name;
+    size_t (*fn)(const char *);
+} variant_t;
+
+static variant_t variants[10];
+static int nvariants;
+static volatile size_t sink;
+
+int main(void)
+{
+    static const size_t ranges[][2] = {
+        {0, 15}, {16, 63}, {64, 255}, {1024, 4095}, {1 << 20, 1 << 20},
+    };
+    rng_t r;
+
+    variants[nvariants++] = (variant_t){"glibc strlen", glibc_strlen};
+    variants[nvariants++] = (variant_t){"word strlen", word_strlen};
+#ifdef MEMCHR_OPT_SIMD
+    variants[nvariants++] = (variant_t){"SSE2 strlen", sse2_strlen};
+    if (__builtin_cpu_supports("avx2"))
+        variants[nvariants++] = (variant_t){"AVX2 strlen", avx2_strlen};
+#endif
+    variants[nvariants++] = (variant_t){"strlen_opt", opt_strlen};
+    variants[nvariants++] = (variant_t){"glibc strchr", glibc_strchr};
+    variants[nvariants++] = (variant_t){"strchr_opt", opt_strchr};
+    variants[nvariants++] = (variant_t){"glibc strnlen", glibc_strnlen};
+    variants[nvariants++] = (variant_t){"strnlen_opt", opt_strnlen};
+
+    rng_seed(&r, 1);
+    for (size_t k = 0; k < sizeof(ranges) / sizeof(ranges[0]); k++) {
+        size_t lo = ranges[k][0], hi = ranges[k][1];
+        size_t slot = hi + 64, count = (16 << 20) / slot;
+        if (count > 4096)
+            count = 4096;
+        if (!count)
+            count = 1;
+        char *pool = malloc(count * slot);
+        const char **strs = malloc(count * sizeof(*strs));
+        size_t bytes = 0;
+        if (!pool || !strs)
+            return 1;
+        memset(pool, 'x', count * slot);
+        for (size_t i = 0; i < count; i++) {
+            size_t len = lo + rng_bounded(&r, hi - lo + 1);
+            char *s = pool + i * slot + rng_bounded(&r, 64);
+            s[len] = '\0';
+            strs[i] = s;
+            bytes += len;
+        }
+
+        /* About 2^28 bytes or 2^22 calls, whichever comes first */
+        size_t rounds = (1 << 28) / (bytes + 1);
+        if (rounds > (1 << 22) / count)
+            rounds = (1 << 22) / count;
+        rounds++;
+        printf("lengths %zu..%zu:\n", lo, hi);
+        for (int v = 0; v < nvariants; v++) {
+            double t0 = now_ns();
+            for (size_t round = 0; round < rounds; round++) {
+                for (size_t i = 0; i < count; i++)
+                    sink += variants[v].fn(strs[i]);
+            }
+            double ns = now_ns() - t0;
+            printf("  %-16s %9.2f ns/call %7.2f GB/s\n", variants[v].name,
+                   ns / (rounds * count), bytes * rounds / ns);
+        }
+        free(strs);
+        free(pool);
+    }
+    return 0;
+}
@@ -0,0 +1,220 @@
+/* Zero-copy line splitting over mapped files */
+
+#ifndef LINES_H
+#define LINES_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "memchr_opt.h"
+
+/*
+ * A file is mapped read-only and its lines are handed out as (ptr, len)
+ * slices of the mapping: nothing is copied and nothing is allocated per
+ * line. A slice is not NUL-terminated and stays valid until the file is
+ * unmapped. Lines end at '\n', which the slice leaves out; a last line
+ * without one is still a line, and a '\r' before the '\n' is kept.
+ *
+ * For more than one thread, lines_split() cuts a buffer into pieces that
+ * start and end on line boundaries, and lines_parallel() runs a function on
+ * each piece in its own thread.
+ */
+
+typedef struct {
+    const char *ptr;
+    size_t len;
+} line_t;
+
+typedef struct {
+    const char *data;
+    size_t size;
+} mapped_file_t;
+
+typedef struct {
+    const char *pos, *end;
+} line_iter_t;
+
+/**
+ * Maps a file read-only, advised for one pass from start to end.
+ *
+ * @f : Receives the mapping. An empty file gives data NULL and size 0.
+ * @path : File to map.
+ * Return 0, or -1 with errno set.
+ */
+static inline int mapped_file_open(mapped_file_t *f, const char *path)
+{
+    struct stat st;
+    int fd = open(path, O_RDONLY | O_CLOEXEC), err;
+
+    f->data = NULL;
+    f->size = 0;
+    if (fd < 0)
+        return -1;
+    if (fstat(fd, &st) < 0)
+        goto fail;
+    if (!S_ISREG(st.st_mode)) {
+        errno = EINVAL;
+        goto fail;
+    }
+    if (st.st_size > 0) {
+        void *p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED)
+            goto fail;
+        /* Read ahead aggressively and drop pages once they are behind us */
+        madvise(p, st.st_size, MADV_SEQUENTIAL);
+        f->data = p;
+        f->size = st.st_size;
+    }
+    close(fd);
+    return 0;
+
+fail:
+    err = errno;
+    close(fd);
+    errno = err;
+    return -1;
+}
+
+static inline void mapped_file_close(mapped_file_t *f)
+{
+    if (f->size)
+        munmap((void *) f->data, f->size);
+    f->data = NULL;
+    f->size = 0;
+}
+
+static inline void line_iter_init(line_iter_t *it, const char *buf, size_t len)
+{
+    it->pos = buf;
+    it->end = buf + len;
+}
+
+/**
+ * Yields the next line.
+ *
+ * @it : Iterator set up by line_iter_init().
+ * @line : Receives the line, without its '\n'.
+ * Return 1 if there was a line, or 0 at the end of the buffer.
+ */
+static inline int line_iter_next(line_iter_t *it, line_t *line)
+{
+    const char *nl;
+
+    if (it->pos == it->end)
+        return 0;
+    nl = memchr_opt(it->pos, '\n', it->end - it->pos);
+    line->ptr = it->pos;
+    if (nl) {
+        line->len = nl - it->pos;
+        it->pos = nl + 1;
+    } else {
+        line->len = it->end - it->pos;
+        it->pos = it->end;
+    }
+    return 1;
+}
+
+/**
+ * Cuts a buffer into pieces of about equal size on line boundaries.
+ *
+ * @buf, @len : The buffer.
+ * @parts : Number of pieces, at least 1.
+ * @bounds : Receives parts + 1 offsets: piece i is [bounds[i], bounds[i + 1]).
+ *
+ * Each cut moves forward to the start of the next line, so every line lies
+ * in exactly one piece. Lines longer than len / parts leave some pieces
+ * empty.
+ */
+static inline void lines_split(const char *buf,
+                               size_t len,
+                               int parts,
+                               size_t *bounds)
+{
+    bounds[0] = 0;
+    for (int i = 1; i < parts; i++) {
+        size_t at = len / parts * i;
+        if (at < bounds[i - 1])
+            at = bounds[i - 1];
+        /* A line starts at 'at' if the byte before it is a '\n' */
+        if (at > 0) {
+            const char *nl = memchr_opt(buf + at - 1, '\n', len - at + 1);
+            at = nl ? (size_t) (nl + 1 - buf) : len;
+        }
+        bounds[i] = at;
+    }
+    bounds[parts] = len;
+}
+
+/* Upper bound on the threads of lines_parallel() */
+#define LINES_MAX_THREADS 256
+
+/* Called on one piece of the buffer; @part counts from 0 */
+typedef void (*lines_fn)(const char *buf, size_t len, int part, void *arg);
+
+typedef struct {
+    lines_fn fn;
+    void *arg;
+    const char *buf;
+    size_t len;
+    int part;
+} _lines_job_t;
+
+static void *_lines_worker(void *p)
+{
+    _lines_job_t *job = p;
+    job->fn(job->buf, job->len, job->part, job->arg);
+    return NULL;
+}
+
+/**
+ * Runs a function on each piece of a buffer in parallel.
+ *
+ * @buf, @len : The buffer.
+ * @nthreads : Number of pieces and threads, clamped to 1 .. LINES_MAX_THREADS.
+ * @fn : Called once per piece, with the piece number as @part, so it can
+ *       keep per-thread state in an array indexed by it.
+ * @arg : Passed to @fn.
+ *
+ * Pieces come from lines_split(). The calling thread takes piece 0 and
+ * waits for the others; a piece whose thread cannot be created also runs on
+ * the calling thread, so every piece is processed exactly once.
+ */
+static inline void lines_parallel(const char *buf,
+                                  size_t len,
+                                  int nthreads,
+                                  lines_fn fn,
+                                  void *arg)
+{
+    size_t bounds[LINES_MAX_THREADS + 1];
+    _lines_job_t jobs[LINES_MAX_THREADS];
+    pthread_t tids[LINES_MAX_THREADS];
+    int started[LINES_MAX_THREADS];
+
+    if (nthreads < 1)
+        nthreads = 1;
+    if (nthreads > LINES_MAX_THREADS)
+        nthreads = LINES_MAX_THREADS;
+    lines_split(buf, len, nthreads, bounds);
+
+    for (int i = 0; i < nthreads; i++) {
+        jobs[i] = (_lines_job_t){fn, arg, buf + bounds[i],
+                                 bounds[i + 1] - bounds[i], i};
+        started[i] =
+            i > 0 && !pthread_create(&tids[i], NULL, _lines_worker, &jobs[i]);
+    }
+    for (int i = 0; i < nthreads; i++) {
+        if (!started[i])
+            _lines_worker(&jobs[i]);
+    }
+    for (int i = 1; i < nthreads; i++) {
+        if (started[i])
+            pthread_join(tids[i], NULL);
+    }
+}
+
+#endif /* LINES_H */
@@ -0,0 +1,451 @@
+/* Byte search: memchr, memrchr and multi-needle variants */
+
+#ifndef MEMCHR_OPT_H
+#define MEMCHR_OPT_H
+
+#include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../common/bitops.h"
+
+/*
+ * On x86-64, every search compares whole vectors against the needle and
+ * turns the result into a bit mask with movemask: 16 bytes per compare with
+ * SSE2, which every x86-64 CPU has, or 32 with AVX2 where the CPU supports
+ * it, checked at run time. The main loops cover 64 aligned bytes per
+ * iteration and test all of them with a single branch.
+ *
+ * Loads are aligned to the vector size. The first and last vectors may
+ * reach outside the buffer, but never across an aligned boundary, so never
+ * into another page; the bytes outside are masked off. Such reads are
+ * invisible to the program but not to AddressSanitizer or ThreadSanitizer,
+ * which are told to look away.
+ *
+ * Elsewhere, or with -DMEMCHR_OPT_PORTABLE, memchr_opt() reads a word at a
+ * time and the others a byte at a time.
+ */
+
+/* Nonzero if X is not aligned on a "long" boundary */
+#define UNALIGNED(X) ((long) X & (sizeof(long) - 1))
+
+/* How many bytes are loaded each iteration of the word copy loop */
+#define LBLOCKSIZE (sizeof(long))
+
+/* Threshhold for punting to the bytewise iterator */
+#define TOO_SMALL(LEN) ((LEN) < LBLOCKSIZE)
+
+#if LONG_MAX == 2147483647L
+#define DETECT_NULL(X) (((X) - (0x01010101)) & ~(X) & (0x80808080))
+#else
+#if LONG_MAX == 9223372036854775807L
+/* Nonzero if X (a long int) contains a NULL byte. */
+#define DETECT_NULL(X) \
+    (((X) - (0x0101010101010101)) & ~(X) & (0x8080808080808080))
+#else
+#error long int is not a 32bit or 64bit type.
+#endif
+#endif
+
+/* @return nonzero if (long)X contains the byte used to fill MASK. */
+#define DETECT_CHAR(X, mask) DETECT_NULL(X ^ mask)
+
+static inline void *_memchr_swar(const void *str, int c, size_t len)
+{
+    const unsigned char *src = (const unsigned char *) str;
+    unsigned char d = c;
+
+    while (UNALIGNED(src)) {
+        if (!len--)
+            return NULL;
+        if (*src == d)
+            return (void *) src;
+        src++;
+    }
+
+    if (!TOO_SMALL(len)) {
+        /* If we get this far, len is large and src is word-aligned. */
+
+        /* The fast code reads the source one word at a time and only performs
+         * a bytewise search on word-sized segments if they contain the search
+         * character. This is detected by XORing the word-sized segment with a
+         * word-sized block of the search character, and then checking for the
+         * presence of NULL in the result.
+         */
+        unsigned long *asrc = (unsigned long *) src;
+        /* d in every byte: ~0UL / 0xff is 0x0101...01 for any width. */
+        unsigned long mask = d * (~0UL / 0xff);
+
+        while (len >= LBLOCKSIZE) {
+            if (DETECT_CHAR(asrc[0], mask))
+                break;
+            asrc++;
+            len -= LBLOCKSIZE;
+        }
+
+        /* If there are fewer than LBLOCKSIZE characters left, then we resort to
+         * the bytewise loop.
+         */
+        src = (unsigned char *) asrc;
+    }
+
+    while (len--) {
+        if (*src == d)
+            return (void *) src;
+        src++;
+    }
+
+    return NULL;
+}
+
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(MEMCHR_OPT_PORTABLE)
+#include <immintrin.h>
+
+#define MEMCHR_OPT_SIMD 1
+
+#define _MEMCHR_KERNEL \
+    static inline __attribute__((no_sanitize_address, no_sanitize_thread))
+#define _MEMCHR_KERNEL_AVX2 \
+    _MEMCHR_KERNEL __attribute__((target("avx2")))
+
+/* 0xff in every byte of @x equal to one of the first @k needles. @k is a
+ * constant wherever this is inlined, so the unused compares vanish.
+ */
+static inline __attribute__((always_inline)) __m128i
+_memchr_eq_sse2(__m128i x, __m128i a, __m128i b, __m128i c, int k)
+{
+    __m128i eq = _mm_cmpeq_epi8(x, a);
+    if (k > 1)
+        eq = _mm_or_si128(eq, _mm_cmpeq_epi8(x, b));
+    if (k > 2)
+        eq = _mm_or_si128(eq, _mm_cmpeq_epi8(x, c));
+    return eq;
+}
+
+static inline __attribute__((always_inline, target("avx2"))) __m256i
+_memchr_eq_avx2(__m256i x, __m256i a, __m256i b, __m256i c, int k)
+{
+    __m256i eq = _mm256_cmpeq_epi8(x, a);
+    if (k > 1)
+        eq = _mm256_or_si256(eq, _mm256_cmpeq_epi8(x, b));
+    if (k > 2)
+        eq = _mm256_or_si256(eq, _mm256_cmpeq_epi8(x, c));
+    return eq;
+}
+
+#define _MEMCHR_SSE2(p) \
+    ((uint32_t) _mm_movemask_epi8(_memchr_eq_sse2( \
+        _mm_load_si128((const __m128i *) (p)), a, b, c, k)))
+#define _MEMCHR_AVX2(p) \
+    ((uint32_t) _mm256_movemask_epi8(_memchr_eq_avx2( \
+        _mm256_load_si256((const __m256i *) (p)), a, b, c, k)))
+
+/* First byte of s[0 .. n) equal to one of @k needles; n > 0 */
+_MEMCHR_KERNEL const unsigned char *_memchr_fwd_sse2(const unsigned char *s,
+                                                     size_t n,
+                                                     int k,
+                                                     int c1,
+                                                     int c2,
+                                                     int c3)
+{
+    const __m128i a = _mm_set1_epi8(c1), b = _mm_set1_epi8(c2),
+                  c = _mm_set1_epi8(c3);
+    size_t off = (uintptr_t) s & 15;
+    const unsigned char *p = s - off;
+    uint32_t m = _MEMCHR_SSE2(p) >> off;
+
+    if (m)
+        return (size_t) ctz32(m) < n ? s + ctz32(m) : NULL;
+    if (n <= 16 - off)
+        return NULL;
+    n -= 16 - off;
+    p += 16;
+
+    /* Up to a 64-byte boundary first, so that a block of the main loop
+     * never reaches into the page after the match: callers may pass a
+     * length beyond the object when the byte is sure to occur in it.
+     */
+    for (; n >= 16 && ((uintptr_t) p & 63); n -= 16, p += 16) {
+        if ((m = _MEMCHR_SSE2(p)))
+            return p + ctz32(m);
+    }
+    for (; n >= 64; n -= 64, p += 64) {
+        __m128i e0 = _memchr_eq_sse2(_mm_load_si128((const __m128i *) p), a,
+                                     b, c, k);
+        __m128i e1 = _memchr_eq_sse2(
+            _mm_load_si128((const __m128i *) (p + 16)), a, b, c, k);
+        __m128i e2 = _memchr_eq_sse2(
+            _mm_load_si128((const __m128i *) (p + 32)), a, b, c, k);
+        __m128i e3 = _memchr_eq_sse2(
+            _mm_load_si128((const __m128i *) (p + 48)), a, b, c, k);
+        __m128i any = _mm_or_si128(_mm_or_si128(e0, e1), _mm_or_si128(e2, e3));
+        if (_mm_movemask_epi8(any)) {
+            uint64_t mm = (uint64_t) _mm_movemask_epi8(e0) |
+                          (uint64_t) _mm_movemask_epi8(e1) << 16 |
+                          (uint64_t) _mm_movemask_epi8(e2) << 32 |
+                          (uint64_t) _mm_movemask_epi8(e3) << 48;
+            return p + ctz64(mm);
+        }
+    }
+    for (; n >= 16; n -= 16, p += 16) {
+        if ((m = _MEMCHR_SSE2(p)))
+            return p + ctz32(m);
+    }
+    if (n && (m = _MEMCHR_SSE2(p) & ((1U << n) - 1)))
+        return p + ctz32(m);
+    return NULL;
+}
+
+_MEMCHR_KERNEL_AVX2 const unsigned char *_memchr_fwd_avx2(
+    const unsigned char *s,
+    size_t n,
+    int k,
+    int c1,
+    int c2,
+    int c3)
+{
+    const __m256i a = _mm256_set1_epi8(c1), b = _mm256_set1_epi8(c2),
+                  c = _mm256_set1_epi8(c3);
+    size_t off = (uintptr_t) s & 31;
+    const unsigned char *p = s - off;
+    uint32_t m = _MEMCHR_AVX2(p) >> off;
+
+    if (m)
+        return (size_t) ctz32(m) < n ? s + ctz32(m) : NULL;
+    if (n <= 32 - off)
+        return NULL;
+    n -= 32 - off;
+    p += 32;
+
+    if (n >= 32 && ((uintptr_t) p & 63)) {
+        if ((m = _MEMCHR_AVX2(p)))
+            return p + ctz32(m);
+        n -= 32;
+        p += 32;
+    }
+    for (; n >= 64; n -= 64, p += 64) {
+        __m256i e0 = _memchr_eq_avx2(_mm256_load_si256((const __m256i *) p),
+                                     a, b, c, k);
+        __m256i e1 = _memchr_eq_avx2(
+            _mm256_load_si256((const __m256i *) (p + 32)), a, b, c, k);
+        if (_mm256_movemask_epi8(_mm256_or_si256(e0, e1))) {
+            uint64_t mm = (uint32_t) _mm256_movemask_epi8(e0) |
+                          (uint64_t) (uint32_t) _mm256_movemask_epi8(e1) << 32;
+            return p + ctz64(mm);
+        }
+    }
+    if (n >= 32) {
+        if ((m = _MEMCHR_AVX2(p)))
+            return p + ctz32(m);
+        n -= 32;
+        p += 32;
+    }
+    if (n && (m = _MEMCHR_AVX2(p) & ((1U << n) - 1)))
+        return p + ctz32(m);
+    return NULL;
+}
+
+/* Last byte of s[0 .. n) equal to @a; n > 0 */
+_MEMCHR_KERNEL const unsigned char *_memrchr_sse2(const unsigned char *s,
+                                                  size_t n,
+                                                  int c1)
+{
+    const __m128i a = _mm_set1_epi8(c1), b = a, c = a;
+    const int k = 1;
+    size_t off = (uintptr_t) (s + n) & 15;
+    const unsigned char *p = s + n - off;
+    uint32_t m;
+
+    /* The block holding the end, up to the end and from s on */
+    if (off) {
+        m = _MEMCHR_SSE2(p) & ((1U << off) - 1);
+        if (p < s)
+            m &= ~0U << (s - p);
+        if (m)
+            return p + 31 - clz32(m);
+        if (p <= s)
+            return NULL;
+    }
+
+    for (; p - s >= 64;) {
+        p -= 64;
+        __m128i e0 = _mm_cmpeq_epi8(_mm_load_si128((const __m128i *) p), a);
+        __m128i e1 =
+            _mm_cmpeq_epi8(_mm_load_si128((const __m128i *) (p + 16)), a);
+        __m128i e2 =
+            _mm_cmpeq_epi8(_mm_load_si128((const __m128i *) (p + 32)), a);
+        __m128i e3 =
+            _mm_cmpeq_epi8(_mm_load_si128((const __m128i *) (p + 48)), a);
+        __m128i any = _mm_or_si128(_mm_or_si128(e0, e1), _mm_or_si128(e2, e3));
+        if (_mm_movemask_epi8(any)) {
+            uint64_t mm = (uint64_t) _mm_movemask_epi8(e0) |
+                          (uint64_t) _mm_movemask_epi8(e1) << 16 |
+                          (uint64_t) _mm_movemask_epi8(e2) << 32 |
+                          (uint64_t) _mm_movemask_epi8(e3) << 48;
+            return p + 63 - clz64(mm);
+        }
+    }
+    for (; p - s >= 16;) {
+        p -= 16;
+        if ((m = _MEMCHR_SSE2(p)))
+            return p + 31 - clz32(m);
+    }
+    if (p > s) {
+        p -= 16;
+        if ((m = _MEMCHR_SSE2(p) & (~0U << (s - p))))
+            return p + 31 - clz32(m);
+    }
+    return NULL;
+}
+
+_MEMCHR_KERNEL_AVX2 const unsigned char *_memrchr_avx2(
+    const unsigned char *s,
+    size_t n,
+    int c1)
+{
+    const __m256i a = _mm256_set1_epi8(c1), b = a, c = a;
+    const int k = 1;
+    size_t off = (uintptr_t) (s + n) & 31;
+    const unsigned char *p = s + n - off;
+    uint32_t m;
+
+    if (off) {
+        m = _MEMCHR_AVX2(p) & ((1U << off) - 1);
+        if (p < s)
+            m &= ~0U << (s - p);
+        if (m)
+            return p + 31 - clz32(m);
+        if (p <= s)
+            return NULL;
+    }
+
+    for (; p - s >= 64;) {
+        p -= 64;
+        __m256i e0 =
+            _mm256_cmpeq_epi8(_mm256_load_si256((const __m256i *) p), a);
+        __m256i e1 =
+            _mm256_cmpeq_epi8(_mm256_load_si256((const __m256i *) (p + 32)), a);
+        if (_mm256_movemask_epi8(_mm256_or_si256(e0, e1))) {
+            uint64_t mm = (uint32_t) _mm256_movemask_epi8(e0) |
+                          (uint64_t) (uint32_t) _mm256_movemask_epi8(e1) << 32;
+            return p + 63 - clz64(mm);
+        }
+    }
+    if (p - s >= 32) {
+        p -= 32;
+        if ((m = _MEMCHR_AVX2(p)))
+            return p + 31 - clz32(m);
+    }
+    if (p > s) {
+        p -= 32;
+        if ((m = _MEMCHR_AVX2(p) & (~0U << (s - p))))
+            return p + 31 - clz32(m);
+    }
+    return NULL;
+}
+
+/* Forward search for up to three needles on the best vector unit */
+static inline void *_memchr_fwd(const void *s, size_t n, int k, int c1, int c2,
+                                int c3)
+{
+    if (!n)
+        return NULL;
+    if (__builtin_cpu_supports("avx2"))
+        return (void *) _memchr_fwd_avx2(s, n, k, c1, c2, c3);
+    return (void *) _memchr_fwd_sse2(s, n, k, c1, c2, c3);
+}
+#endif
+
+/**
+ * Finds the first occurrence of a byte, as memchr().
+ *
+ * @str : Start of the buffer.
+ * @c : Byte to find, converted to unsigned char.
+ * @len : Length of the buffer.
+ * Return a pointer to the byte, or NULL if it does not occur.
+ */
+static inline void *memchr_opt(const void *str, int c, size_t len)
+{
+#ifdef MEMCHR_OPT_SIMD
+    return _memchr_fwd(str, len, 1, c, c, c);
+#else
+    return _memchr_swar(str, c, len);
+#endif
+}
+
+/**
+ * Finds the first byte equal to either of two values.
+ *
+ * @str : Start of the buffer.
+ * @c1, @c2 : Bytes to find.
+ * @len : Length of the buffer.
+ * Return a pointer to the byte, or NULL if neither occurs.
+ */
+static inline void *memchr2_opt(const void *str, int c1, int c2, size_t len)
+{
+#ifdef MEMCHR_OPT_SIMD
+    return _memchr_fwd(str, len, 2, c1, c2, c2);
+#else
+    const unsigned char *s = str;
+    for (size_t i = 0; i < len; i++) {
+        if (s[i] == (unsigned char) c1 || s[i] == (unsigned char) c2)
+            return (void *) (s + i);
+    }
+    return NULL;
+#endif
+}
+
+/**
+ * Finds the first byte equal to any of three values.
+ *
+ * @str : Start of the buffer.
+ * @c1, @c2, @c3 : Bytes to find.
+ * @len : Length of the buffer.
+ * Return a pointer to the byte, or NULL if none occurs.
+ */
+static inline void *memchr3_opt(const void *str,
+                                int c1,
+                                int c2,
+                                int c3,
+                                size_t len)
+{
+#ifdef MEMCHR_OPT_SIMD
+    return _memchr_fwd(str, len, 3, c1, c2, c3);
+#else
+    const unsigned char *s = str;
+    for (size_t i = 0; i < len; i++) {
+        if (s[i] == (unsigned char) c1 || s[i] == (unsigned char) c2 ||
+            s[i] == (unsigned char) c3)
+            return (void *) (s + i);
+    }
+    return NULL;
+#endif
+}
+
+/**
+ * Finds the last occurrence of a byte, as GNU memrchr().
+ *
+ * @str : Start of the buffer.
+ * @c : Byte to find, converted to unsigned char.
+ * @len : Length of the buffer.
+ * Return a pointer to the byte, or NULL if it does not occur.
+ */
+static inline void *memrchr_opt(const void *str, int c, size_t len)
+{
+    if (!len)
+        return NULL;
+#ifdef MEMCHR_OPT_SIMD
+    if (__builtin_cpu_supports("avx2"))
+        return (void *) _memrchr_avx2(str, len, c);
+    return (void *) _memrchr_sse2(str, len, c);
+#else
+    const unsigned char *s = str;
+    while (len--) {
+        if (s[len] == (unsigned char) c)
+            return (void *) (s + len);
+    }
+    return NULL;
+#endif
+}
+
+#endif /* MEMCHR_OPT_H */
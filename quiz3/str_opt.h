@@ -0,0 +1,207 @@
+/* NUL-terminated string scans: strlen, strchr and strnlen */
+
+#ifndef STR_OPT_H
+#define STR_OPT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "memchr_opt.h"
+
+/*
+ * A string's length is not known until its NUL is found, so these read
+ * ahead of it in aligned blocks: an aligned word, vector or group of
+ * vectors never spans two pages, so the block holding the NUL is readable
+ * whenever the NUL is. The one unaligned read, of the first 16 bytes,
+ * is only made when they lie on a single page. The bytes after the NUL are
+ * ignored but still read, which AddressSanitizer and ThreadSanitizer would
+ * report.
+ *
+ * The vector kernels look for a byte x that is NUL or equal to the needle v
+ * with a single compare: min(x ^ v, x) is zero exactly for those. For
+ * strlen v is 0 and this is x == 0. After the first vector they step up to
+ * a 64-byte boundary and then test 64 bytes per iteration, the same width
+ * as memchr_opt(). strnlen_opt() is memchr_opt() for a NUL, which stops in
+ * the aligned block where it finds one.
+ */
+
+#ifdef __GNUC__
+#define _STR_OPT_OVERREAD \
+    __attribute__((no_sanitize_address, no_sanitize_thread))
+#else
+#define _STR_OPT_OVERREAD
+#endif
+
+/* First byte of @str equal to (char) @c, or its NUL: as GNU strchrnul() */
+static inline _STR_OPT_OVERREAD const char *_strchrnul_swar(const char *str,
+                                                             int c)
+{
+    const unsigned char *src = (const unsigned char *) str;
+    unsigned char d = c;
+
+    while (UNALIGNED(src)) {
+        if (*src == d || !*src)
+            return (const char *) src;
+        src++;
+    }
+
+    /* Whole words until one holds the NUL or d; d in every byte of mask */
+    const unsigned long *asrc = (const unsigned long *) src;
+    unsigned long mask = d * (~0UL / 0xff);
+    while (!DETECT_NULL(*asrc) && !DETECT_CHAR(*asrc, mask))
+        asrc++;
+
+    src = (const unsigned char *) asrc;
+    while (*src && *src != d)
+        src++;
+    return (const char *) src;
+}
+
+#ifdef MEMCHR_OPT_SIMD
+/* Zero in every byte of @x that is NUL or equal to the bytes of @v */
+#define _STR_HIT_SSE2(x) _mm_min_epu8(_mm_xor_si128((x), v), (x))
+#define _STR_HIT_AVX2(x) _mm256_min_epu8(_mm256_xor_si256((x), v), (x))
+#define _STR_MASK_SSE2(p)                  \
+    ((uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8( \
+        _STR_HIT_SSE2(_mm_load_si128((const __m128i *) (p))), zero)))
+#define _STR_MASK_AVX2(p)                       \
+    ((uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8( \
+        _STR_HIT_AVX2(_mm256_load_si256((const __m256i *) (p))), zero)))
+
+_MEMCHR_KERNEL const char *_strchrnul_sse2(const char *s, int c)
+{
+    const __m128i v = _mm_set1_epi8(c), zero = _mm_setzero_si128();
+    size_t off = (uintptr_t) s & 15;
+    const char *p = s - off;
+    uint32_t m = _STR_MASK_SSE2(p) >> off;
+
+    if (m)
+        return s + ctz32(m);
+    for (p += 16; (uintptr_t) p & 63; p += 16) {
+        if ((m = _STR_MASK_SSE2(p)))
+            return p + ctz32(m);
+    }
+    for (;; p += 64) {
+        __m128i h0 = _STR_HIT_SSE2(_mm_load_si128((const __m128i *) p));
+        __m128i h1 =
+            _STR_HIT_SSE2(_mm_load_si128((const __m128i *) (p + 16)));
+        __m128i h2 =
+            _STR_HIT_SSE2(_mm_load_si128((const __m128i *) (p + 32)));
+        __m128i h3 =
+            _STR_HIT_SSE2(_mm_load_si128((const __m128i *) (p + 48)));
+        __m128i low = _mm_min_epu8(_mm_min_epu8(h0, h1), _mm_min_epu8(h2, h3));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(low, zero))) {
+            uint64_t mm =
+                (uint64_t) _mm_movemask_epi8(_mm_cmpeq_epi8(h0, zero)) |
+                (uint64_t) _mm_movemask_epi8(_mm_cmpeq_epi8(h1, zero)) << 16 |
+                (uint64_t) _mm_movemask_epi8(_mm_cmpeq_epi8(h2, zero)) << 32 |
+                (uint64_t) _mm_movemask_epi8(_mm_cmpeq_epi8(h3, zero)) << 48;
+            return p + ctz64(mm);
+        }
+    }
+}
+
+_MEMCHR_KERNEL_AVX2 const char *_strchrnul_avx2(const char *s, int c)
+{
+    const __m256i v = _mm256_set1_epi8(c), zero = _mm256_setzero_si256();
+    size_t off = (uintptr_t) s & 31;
+    const char *p = s - off;
+    uint32_t m = _STR_MASK_AVX2(p) >> off;
+
+    if (m)
+        return s + ctz32(m);
+    p += 32;
+    if ((uintptr_t) p & 63) {
+        if ((m = _STR_MASK_AVX2(p)))
+            return p + ctz32(m);
+        p += 32;
+    }
+    for (;; p += 64) {
+        __m256i h0 = _STR_HIT_AVX2(_mm256_load_si256((const __m256i *) p));
+        __m256i h1 =
+            _STR_HIT_AVX2(_mm256_load_si256((const __m256i *) (p + 32)));
+        __m256i low = _mm256_min_epu8(h0, h1);
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(low, zero))) {
+            uint64_t mm =
+                (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(h0, zero)) |
+                (uint64_t) (uint32_t) _mm256_movemask_epi8(
+                    _mm256_cmpeq_epi8(h1, zero))
+                    << 32;
+            return p + ctz64(mm);
+        }
+    }
+}
+#endif
+
+static inline _STR_OPT_OVERREAD const char *_strchrnul(const char *s, int c)
+{
+#ifdef MEMCHR_OPT_SIMD
+    /* Most strings are short. When the 16 bytes at s are all on its page
+     * (x86 pages are at least 4 KiB), one unaligned load settles them here
+     * without the call and the CPU check.
+     */
+    if (((uintptr_t) s & 4095) <= 4096 - 16) {
+        const __m128i v = _mm_set1_epi8(c), zero = _mm_setzero_si128();
+        uint32_t m = (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(
+            _STR_HIT_SSE2(_mm_loadu_si128((const __m128i *) s)), zero));
+        if (m)
+            return s + ctz32(m);
+    }
+    if (__builtin_cpu_supports("avx2"))
+        return _strchrnul_avx2(s, c);
+    return _strchrnul_sse2(s, c);
+#else
+    return _strchrnul_swar(s, c);
+#endif
+}
+
+/**
+ * Measures a string, as strlen().
+ *
+ * @s : NUL-terminated string.
+ * Return the number of bytes before the NUL.
+ */
+static inline size_t strlen_opt(const char *s)
+{
+    return _strchrnul(s, 0) - s;
+}
+
+/**
+ * Finds the first occurrence of a character, as strchr().
+ *
+ * @s : NUL-terminated string.
+ * @c : Character to find, converted to char. For 0, the terminating NUL.
+ * Return a pointer to the character, or NULL if it does not occur.
+ */
+static inline char *strchr_opt(const char *s, int c)
+{
+    const char *p = _strchrnul(s, c);
+    return *p == (char) c ? (char *) p : NULL;
+}
+
+/**
+ * Measures a string that may not be terminated, as strnlen().
+ *
+ * @s : String, readable up to its NUL or @maxlen bytes, whichever is first.
+ * @maxlen : Most bytes to look at.
+ * Return the number of bytes before the NUL, or @maxlen if there is none.
+ */
+static inline _STR_OPT_OVERREAD size_t strnlen_opt(const char *s,
+                                                    size_t maxlen)
+{
+#ifdef MEMCHR_OPT_SIMD
+    /* s itself need not be readable when maxlen is 0 */
+    if (maxlen && ((uintptr_t) s & 4095) <= 4096 - 16) {
+        uint32_t m = (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(
+            _mm_loadu_si128((const __m128i *) s), _mm_setzero_si128()));
+        if (m)
+            return (size_t) ctz32(m) < maxlen ? (size_t) ctz32(m) : maxlen;
+        if (maxlen <= 16)
+            return maxlen;
+    }
+#endif
+    const char *p = memchr_opt(s, 0, maxlen);
+    return p ? (size_t) (p - s) : maxlen;
+}
+
+#endif /* STR_OPT_H */
@@ -0,0 +1,267 @@
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../common/rng.h"
+#include "lines.h"
+
+#define my_assert(test, message) \
+    do {                         \
+        if (!(test))             \
+            return message;      \
+    } while (0)
+#define my_run_test(test)       \
+    do {                        \
+        char *message = test(); \
+        tests_run++;            \
+        if (message)            \
+            return message;     \
+    } while (0)
+
+static char path[] = "/tmp/test-lines.XXXXXX";
+
+/* Replace the scratch file with @len bytes of @data. */
+static int write_file(const char *data, size_t len)
+{
+    FILE *f = fopen(path, "w");
+    if (!f)
+        return 0;
+    size_t done = fwrite(data, 1, len, f);
+    return !fclose(f) && done == len;
+}
+
+/* Lines of buf by a byte loop: start offsets, and lengths without '\n' */
+static size_t ref_lines(const char *buf, size_t len, size_t *off, size_t *n)
+{
+    size_t count = 0, start = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (buf[i] == '\n') {
+            off[count] = start;
+            n[count++] = i - start;
+            start = i + 1;
+        }
+    }
+    if (start < len) {
+        off[count] = start;
+        n[count++] = len - start;
+    }
+    return count;
+}
+
+static size_t *want_off, *want_len;
+
+/* Map the scratch file holding @data and check every slice against
+ * ref_lines(): same bytes, and pointing into the mapping.
+ */
+static char *check_file(const char *data, size_t len)
+{
+    mapped_file_t f;
+    line_iter_t it;
+    line_t line;
+    size_t count = ref_lines(data, len, want_off, want_len), i = 0;
+
+    my_assert(write_file(data, len), "cannot write scratch file");
+    my_assert(!mapped_file_open(&f, path), "mapped_file_open failed");
+    my_assert(f.size == len, "mapping has the wrong size");
+    line_iter_init(&it, f.data, f.size);
+    while (line_iter_next(&it, &line)) {
+        my_assert(i < count, "too many lines");
+        my_assert(line.ptr == f.data + want_off[i], "line starts elsewhere");
+        my_assert(line.len == want_len[i], "line has the wrong length");
+        i++;
+    }
+    my_assert(i == count, "too few lines");
+    my_assert(!line_iter_next(&it, &line), "iterator restarted");
+    mapped_file_close(&f);
+    return NULL;
+}
+
+static char *test_edges(void)
+{
+    static const char *cases[] = {
+        "", "\n", "a", "a\n", "a\nb", "\n\n\n", "a\r\nb\r\n", "\nx\n\ny",
+    };
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        char *msg = check_file(cases[i], strlen(cases[i]));
+        if (msg)
+            return msg;
+    }
+    return NULL;
+}
+
+static char *random_text(rng_t *r, size_t len, uint32_t mean)
+{
+    char *buf = malloc(len);
+    for (size_t i = 0; buf && i < len; i++)
+        buf[i] = rng_bounded(r, mean) ? 'a' + rng_bounded(r, 26) : '\n';
+    return buf;
+}
+
+static char *test_random_files(void)
+{
+    rng_t r;
+    rng_seed(&r, 48);
+
+    /* Short lines, long lines, and lines that straddle many vectors */
+    static const uint32_t means[] = {2, 16, 100, 5000};
+    for (size_t m = 0; m < sizeof(means) / sizeof(means[0]); m++) {
+        for (int round = 0; round < 8; round++) {
+            size_t len = 1 + rng_bounded(&r, 1 << 20);
+            char *buf = random_text(&r, len, means[m]);
+            my_assert(buf, "out of memory");
+            char *msg = check_file(buf, len);
+            free(buf);
+            if (msg)
+                return msg;
+        }
+    }
+    return NULL;
+}
+
+static char *test_split(void)
+{
+    rng_t r;
+    size_t bounds[LINES_MAX_THREADS + 1];
+
+    rng_seed(&r, 49);
+    for (int round = 0; round < 2000; round++) {
+        size_t len = rng_bounded(&r, 4096);
+        int parts = 1 + rng_bounded(&r, 40);
+        char *buf = random_text(&r, len + 1, 1 + rng_bounded(&r, 400));
+        my_assert(buf, "out of memory");
+
+        /* Pieces in order, covering the buffer, each cut at a line start */
+        lines_split(buf, len, parts, bounds);
+        int ok = bounds[0] == 0 && bounds[parts] == len;
+        for (int i = 1; ok && i <= parts; i++) {
+            ok = bounds[i - 1] <= bounds[i] &&
+                 (bounds[i] == 0 || bounds[i] == len ||
+                  buf[bounds[i] - 1] == '\n');
+        }
+        /* and no cut passes over a line start it could have stopped at */
+        for (int i = 1; ok && i < parts; i++) {
+            size_t at = len / parts * i;
+            for (size_t j = at > bounds[i - 1] ? at : bounds[i - 1];
+                 ok && j < bounds[i]; j++)
+                ok = j == 0 || buf[j - 1] != '\n';
+        }
+        free(buf);
+        my_assert(ok, "lines_split cut a line");
+    }
+    return NULL;
+}
+
+typedef struct {
+    size_t lines, bytes;
+    uint64_t sum;
+} tally_t;
+
+static tally_t tallies[LINES_MAX_THREADS];
+
+static void tally(const char *buf, size_t len, int part, void *arg)
+{
+    tally_t *t = &tallies[part];
+    line_iter_t it;
+    line_t line;
+
+    (void) arg;
+    line_iter_init(&it, buf, len);
+    while (line_iter_next(&it, &line)) {
+        t->lines++;
+        t->bytes += line.len;
+        /* Position-independent, so that any split adds up the same */
+        for (size_t i = 0; i < line.len; i++)
+            t->sum += (uint64_t) (unsigned char) line.ptr[i] * (i + 1);
+    }
+}
+
+static char *test_parallel(void)
+{
+    static const int threads[] = {1, 2, 3, 4, 7, 8, 64, 1000};
+    rng_t r;
+    size_t len = 1 << 22;
+    tally_t want = {0, 0, 0};
+
+    rng_seed(&r, 50);
+    char *buf = random_text(&r, len, 80);
+    my_assert(buf, "out of memory");
+    memset(tallies, 0, sizeof(tallies));
+    tally(buf, len, 0, NULL);
+    want = tallies[0];
+
+    for (size_t k = 0; k < sizeof(threads) / sizeof(threads[0]); k++) {
+        tally_t got = {0, 0, 0};
+        memset(tallies, 0, sizeof(tallies));
+        lines_parallel(buf, len, threads[k], tally, NULL);
+        for (int i = 0; i < LINES_MAX_THREADS; i++) {
+            got.lines += tallies[i].lines;
+            got.bytes += tallies[i].bytes;
+            got.sum += tallies[i].sum;
+        }
+        if (got.lines != want.lines || got.bytes != want.bytes ||
+            got.sum != want.sum) {
+            free(buf);
+            return "lines_parallel lost or repeated lines";
+        }
+    }
+    free(buf);
+    return NULL;
+}
+
+static char *test_errors(void)
+{
+    mapped_file_t f;
+
+    errno = 0;
+    my_assert(mapped_file_open(&f, "/nonexistent/file") < 0 && errno == ENOENT,
+              "missing file not reported");
+    my_assert(mapped_file_open(&f, "/tmp") < 0 && errno == EINVAL,
+              "directory not refused");
+    my_assert(write_file("", 0) && !mapped_file_open(&f, path) &&
+                  !f.data && !f.size,
+              "empty file not mapped as empty");
+    mapped_file_close(&f);
+    return NULL;
+}
+
+int tests_run = 0;
+
+static char *test_suite(void)
+{
+    my_run_test(test_edges);
+    my_run_test(test_random_files);
+    my_run_test(test_split);
+    my_run_test(test_parallel);
+    my_run_test(test_errors);
+    return NULL;
+}
+
+int main(void)
+{
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        perror("mkstemp");
+        return 1;
+    }
+    close(fd);
+    want_off = malloc((1 << 20) * sizeof(size_t));
+    want_len = malloc((1 << 20) * sizeof(size_t));
+    if (!want_off || !want_len)
+        return 1;
+
+    printf("---=[ lines tests\n");
+    char *result = test_suite();
+    if (result)
+        printf("ERROR: %s\n", result);
+    else
+        printf("ALL TESTS PASSED\n");
+    printf("Tests run: %d\n", tests_run);
+    unlink(path);
+    free(want_len);
+    free(want_off);
+    return !!result;
+}
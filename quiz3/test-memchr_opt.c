@@ -0,0 +1,280 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "../common/rng.h"
+#include "memchr_opt.h"
+
+#define my_assert(test, message) \
+    do {                         \
+        if (!(test))             \
+            return message;      \
+    } while (0)
+#define my_run_test(test)       \
+    do {                        \
+        char *message = test(); \
+        tests_run++;            \
+        if (message)            \
+            return message;     \
+    } while (0)
+
+typedef void *(*chr_fn)(const void *, int, size_t);
+typedef void *(*chr2_fn)(const void *, int, int, size_t);
+typedef void *(*chr3_fn)(const void *, int, int, int, size_t);
+
+/* One implementation of each search; NULL where a path has none */
+typedef struct {
+    const char *name;
+    chr_fn chr, rchr;
+    chr2_fn chr2;
+    chr3_fn chr3;
+} path_t;
+
+#ifdef MEMCHR_OPT_SIMD
+#define PATH(isa)                                                            \
+    static void *isa##_chr(const void *s, int c, size_t n)                   \
+    {                                                                        \
+        return n ? (void *) _memchr_fwd_##isa(s, n, 1, c, c, c) : NULL;      \
+    }                                                                        \
+    static void *isa##_chr2(const void *s, int c1, int c2, size_t n)         \
+    {                                                                        \
+        return n ? (void *) _memchr_fwd_##isa(s, n, 2, c1, c2, c2) : NULL;   \
+    }                                                                        \
+    static void *isa##_chr3(const void *s, int c1, int c2, int c3, size_t n) \
+    {                                                                        \
+        return n ? (void *) _memchr_fwd_##isa(s, n, 3, c1, c2, c3) : NULL;   \
+    }                                                                        \
+    static void *isa##_rchr(const void *s, int c, size_t n)                  \
+    {                                                                        \
+        return n ? (void *) _memrchr_##isa(s, n, c) : NULL;                  \
+    }
+PATH(sse2)
+PATH(avx2)
+#endif
+
+static path_t paths[4];
+static int npaths;
+
+static const unsigned char *ref_chr(const unsigned char *s,
+                                    const unsigned char *c,
+                                    int k,
+                                    size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        for (int j = 0; j < k; j++) {
+            if (s[i] == c[j])
+                return s + i;
+        }
+    }
+    return NULL;
+}
+
+static const unsigned char *ref_rchr(const unsigned char *s, int c, size_t n)
+{
+    while (n--) {
+        if (s[n] == (unsigned char) c)
+            return s + n;
+    }
+    return NULL;
+}
+
+static const char *failed;
+static size_t failed_off, failed_len;
+
+/* Run every path on s[0 .. n) for needles c[0 .. 3) and compare with the
+ * byte loops.
+ */
+static int check(const unsigned char *s, size_t n, const unsigned char *c)
+{
+    const unsigned char *first = ref_chr(s, c, 1, n);
+    const unsigned char *first2 = ref_chr(s, c, 2, n);
+    const unsigned char *first3 = ref_chr(s, c, 3, n);
+    const unsigned char *last = ref_rchr(s, c[0], n);
+
+    for (int p = 0; p < npaths; p++) {
+        const path_t *q = &paths[p];
+        if ((q->chr && q->chr(s, c[0], n) != first) ||
+            (q->chr2 && q->chr2(s, c[0], c[1], n) != first2) ||
+            (q->chr3 && q->chr3(s, c[0], c[1], c[2], n) != first3) ||
+            (q->rchr && q->rchr(s, c[0], n) != last)) {
+            failed = q->name;
+            failed_off = (uintptr_t) s & 63;
+            failed_len = n;
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static char *report(void)
+{
+    static char msg[128];
+    snprintf(msg, sizeof(msg), "%s path wrong at offset %zu, length %zu",
+             failed, failed_off, failed_len);
+    return msg;
+}
+
+static unsigned char buf[1024] __attribute__((aligned(64)));
+
+static char *test_positions(void)
+{
+    static const unsigned char c[3] = {'\n', ',', '"'};
+
+    /* Every start offset within a cache line and every length up to 4
+     * blocks of 64, with needles packed around the range so that a read
+     * outside it finds one. Inside, one needle at each position in turn.
+     */
+    for (size_t off = 0; off < 64; off++) {
+        for (size_t n = 0; n <= 256; n++) {
+            unsigned char *s = buf + 64 + off;
+            for (size_t i = 0; i < sizeof(buf); i++)
+                buf[i] = c[i % 3];
+            memset(s, 'x', n);
+            if (!check(s, n, c))
+                return report();
+            for (size_t pos = 0; pos < n; pos++) {
+                for (int j = 0; j < 3; j++) {
+                    s[pos] = c[j];
+                    if (!check(s, n, c))
+                        return report();
+                }
+                s[pos] = 'x';
+            }
+        }
+    }
+    return NULL;
+}
+
+static char *test_random(void)
+{
+    rng_t r;
+    unsigned char c[3];
+
+    /* Random text over a small alphabet, so every needle turns up at
+     * random distances.
+     */
+    rng_seed(&r, 47);
+    for (int round = 0; round < 20000; round++) {
+        size_t off = rng_bounded(&r, 64);
+        size_t n = rng_bounded(&r, sizeof(buf) - off);
+        uint32_t alphabet = 2 + rng_bounded(&r, 254);
+        for (size_t i = 0; i < sizeof(buf); i++)
+            buf[i] = 0x80 + rng_bounded(&r, alphabet);
+        for (int j = 0; j < 3; j++)
+            c[j] = 0x80 + rng_bounded(&r, alphabet);
+        if (!check(buf + off, n, c))
+            return report();
+    }
+    return NULL;
+}
+
+static char *test_needle_values(void)
+{
+    /* Bytes with the top bit set compare as negative; c is converted to
+     * unsigned char, so -1 and 0x1ff both find 0xff.
+     */
+    for (int v = 0; v < 256; v++) {
+        unsigned char c[3] = {v, v, v};
+        memset(buf, v ^ 1, sizeof(buf));
+        buf[300] = v;
+        if (!check(buf + 3, 500, c))
+            return report();
+    }
+    memset(buf, 0, sizeof(buf));
+    buf[200] = 0xff;
+    for (int p = 0; p < npaths; p++) {
+        const path_t *q = &paths[p];
+        my_assert(q->chr(buf, -1, 500) == buf + 200, "c = -1 not converted");
+        my_assert(q->chr(buf, 0x1ff, 500) == buf + 200,
+                  "c = 0x1ff not converted");
+        my_assert(!q->rchr || q->rchr(buf, -1, 500) == buf + 200,
+                  "memrchr c = -1 not converted");
+    }
+    return NULL;
+}
+
+static char *test_guard_pages(void)
+{
+    static const unsigned char c[3] = {'\n', ',', '"'};
+    size_t page = sysconf(_SC_PAGESIZE);
+    unsigned char *map = mmap(NULL, 3 * page, PROT_READ | PROT_WRITE,
+                              MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    /* One accessible page between two that fault: buffers that start at
+     * its first byte or end at its last must not be read past.
+     */
+    my_assert(map != MAP_FAILED, "mmap failed");
+    my_assert(!mprotect(map, page, PROT_NONE) &&
+                  !mprotect(map + 2 * page, page, PROT_NONE),
+              "mprotect failed");
+    unsigned char *lo = map + page, *hi = map + 2 * page;
+    memset(lo, 'x', page);
+    for (size_t n = 0; n <= 300; n++) {
+        if (!check(lo, n, c) || !check(hi - n, n, c))
+            return report();
+        if (n) {
+            lo[n - 1] = hi[-(ptrdiff_t) n] = ',';
+            if (!check(lo, n, c) || !check(hi - n, n, c))
+                return report();
+            lo[n - 1] = hi[-(ptrdiff_t) n] = 'x';
+        }
+    }
+    munmap(map, 3 * page);
+    return NULL;
+}
+
+static char *test_swar_mask(void)
+{
+    /* Every byte of the word-sized pattern is the needle: a mask built
+     * from half a word would let the upper bytes through.
+     */
+    memset(buf, 0, sizeof(buf));
+    for (size_t i = 0; i < 2 * sizeof(long); i++) {
+        buf[i] = 0x5a;
+        my_assert(_memchr_swar(buf, 0x5a, 64) == buf + i,
+                  "memchr_swar misses a byte of the word");
+        buf[i] = 0;
+    }
+    return NULL;
+}
+
+int tests_run = 0;
+
+static char *test_suite(void)
+{
+    my_run_test(test_positions);
+    my_run_test(test_random);
+    my_run_test(test_needle_values);
+    my_run_test(test_guard_pages);
+    my_run_test(test_swar_mask);
+    return NULL;
+}
+
+int main(void)
+{
+    paths[npaths++] = (path_t){"word", _memchr_swar, NULL, NULL, NULL};
+#ifdef MEMCHR_OPT_SIMD
+    paths[npaths++] = (path_t){"SSE2", sse2_chr, sse2_rchr, sse2_chr2,
+                               sse2_chr3};
+    if (__builtin_cpu_supports("avx2"))
+        paths[npaths++] = (path_t){"AVX2", avx2_chr, avx2_rchr, avx2_chr2,
+                                   avx2_chr3};
+#endif
+    paths[npaths++] = (path_t){"dispatch", memchr_opt, memrchr_opt,
+                               memchr2_opt, memchr3_opt};
+
+    printf("---=[ memchr_opt tests (");
+    for (int p = 0; p < npaths; p++)
+        printf("%s%s", p ? ", " : "", paths[p].name);
+    printf(")\n");
+    char *result = test_suite();
+    if (result)
+        printf("ERROR: %s\n", result);
+    else
+        printf("ALL TESTS PASSED\n");
+    printf("Tests run: %d\n", tests_run);
+    return !!result;
+}
@@ -0,0 +1,179 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "../common/rng.h"
+#include "str_opt.h"
+
+#define my_assert(test, message) \
+    do {                         \
+        if (!(test))             \
+            return message;      \
+    } while (0)
+#define my_run_test(test)       \
+    do {                        \
+        char *message = test(); \
+        tests_run++;            \
+        if (message)            \
+            return message;     \
+    } while (0)
+
+typedef struct {
+    const char *name;
+    const char *(*chrnul)(const char *, int);
+} path_t;
+
+static path_t paths[4];
+static int npaths;
+
+static const char *failed;
+static size_t failed_off, failed_len;
+
+/* Every path, and the public functions, on the string at @s for needle @c */
+static int check(const char *s, int c)
+{
+    size_t len = strlen(s);
+    const char *hit = strchr(s, c);
+    const char *chrnul = hit ? hit : s + len;
+
+    failed_off = (uintptr_t) s & 63;
+    failed_len = len;
+    for (int p = 0; p < npaths; p++) {
+        failed = paths[p].name;
+        if (paths[p].chrnul(s, c) != chrnul || paths[p].chrnul(s, 0) != s + len)
+            return 0;
+    }
+    failed = "public";
+    return strlen_opt(s) == len && strchr_opt(s, c) == hit &&
+           strchr_opt(s, 0) == s + len && strnlen_opt(s, SIZE_MAX) == len &&
+           strnlen_opt(s, len + 1) == len && strnlen_opt(s, len) == len &&
+           (!len || strnlen_opt(s, len - 1) == len - 1);
+}
+
+static char *report(void)
+{
+    static char msg[128];
+    snprintf(msg, sizeof(msg), "%s path wrong at offset %zu, length %zu",
+             failed, failed_off, failed_len);
+    return msg;
+}
+
+static char buf[1024] __attribute__((aligned(64)));
+
+static char *test_positions(void)
+{
+    /* Every start offset within a cache line and every length up to 4
+     * blocks of 64, with the needle at each position in turn and packed
+     * before the string, where a read must not find it.
+     */
+    for (size_t off = 0; off < 64; off++) {
+        for (size_t n = 0; n <= 256; n++) {
+            char *s = buf + 64 + off;
+            memset(buf, ',', sizeof(buf));
+            memset(s, 'x', n);
+            s[n] = '\0';
+            if (!check(s, ','))
+                return report();
+            for (size_t pos = 0; pos < n; pos++) {
+                s[pos] = ',';
+                if (!check(s, ','))
+                    return report();
+                s[pos] = 'x';
+            }
+        }
+    }
+    return NULL;
+}
+
+static char *test_random(void)
+{
+    rng_t r;
+
+    /* Random strings over a small alphabet, with the top bit set on half
+     * of them so that signed and unsigned bytes differ.
+     */
+    rng_seed(&r, 49);
+    for (int round = 0; round < 50000; round++) {
+        size_t off = rng_bounded(&r, 64);
+        size_t n = rng_bounded(&r, sizeof(buf) - off - 1);
+        uint32_t alphabet = 1 + rng_bounded(&r, 255);
+        unsigned char base = rng_bounded(&r, 2) ? 0x80 : 1;
+        for (size_t i = 0; i < sizeof(buf); i++)
+            buf[i] = base + rng_bounded(&r, alphabet);
+        buf[off + n] = '\0';
+        if (!check(buf + off, base + rng_bounded(&r, alphabet)) ||
+            !check(buf + off, (signed char) (base + rng_bounded(&r, alphabet))))
+            return report();
+    }
+    return NULL;
+}
+
+static char *test_guard_pages(void)
+{
+    size_t page = sysconf(_SC_PAGESIZE);
+    char *map = mmap(NULL, 3 * page, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    /* One accessible page between two that fault. Strings that start at
+     * its first byte or end at its last must not be read past, and strnlen
+     * must stop at the NUL even when told it may read on.
+     */
+    my_assert(map != MAP_FAILED, "mmap failed");
+    my_assert(!mprotect(map, page, PROT_NONE) &&
+                  !mprotect(map + 2 * page, page, PROT_NONE),
+              "mprotect failed");
+    char *lo = map + page, *hi = map + 2 * page;
+    for (size_t n = 0; n <= 300; n++) {
+        memset(lo, 'x', page);
+        hi[-1] = '\0';
+        lo[n] = '\0';
+        if (!check(lo, ',') || !check(hi - 1 - n, ','))
+            return report();
+
+        /* No NUL at all: strnlen must not look past maxlen */
+        memset(lo, 'x', page);
+        failed = "public";
+        failed_off = (uintptr_t) (hi - n) & 63;
+        failed_len = n;
+        if (strnlen_opt(hi - n, n) != n || strnlen_opt(lo, n) != n)
+            return report();
+    }
+    munmap(map, 3 * page);
+    return NULL;
+}
+
+int tests_run = 0;
+
+static char *test_suite(void)
+{
+    my_run_test(test_positions);
+    my_run_test(test_random);
+    my_run_test(test_guard_pages);
+    return NULL;
+}
+
+int main(void)
+{
+    paths[npaths++] = (path_t){"word", _strchrnul_swar};
+#ifdef MEMCHR_OPT_SIMD
+    paths[npaths++] = (path_t){"SSE2", _strchrnul_sse2};
+    if (__builtin_cpu_supports("avx2"))
+        paths[npaths++] = (path_t){"AVX2", _strchrnul_avx2};
+#endif
+    paths[npaths++] = (path_t){"dispatch", _strchrnul};
+
+    printf("---=[ str_opt tests (");
+    for (int p = 0; p < npaths; p++)
+        printf("%s%s", p ? ", " : "", paths[p].name);
+    printf(")\n");
+    char *result = test_suite();
+    if (result)
+        printf("ERROR: %s\n", result);
+    else
+        printf("ALL TESTS PASSED\n");
+    printf("Tests run: %d\n", tests_run);
+    return !!result;
+}
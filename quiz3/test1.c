@@ -7,6 +7,8 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "../common/bitops.h"
+
 /* mpi: Multi-Precision Integers */
 typedef struct {
     uint32_t *data;
@@ -647,15 +649,10 @@ size_t mpi_sizeinbase(const mpi_t op, int base)
 {
     assert(base == 2); /* Only binary */
 
-    /* find right-most non-zero word */
+    /* find right-most non-zero word; its highest set bit ends the number */
     for (size_t i = op->capacity - 1; i != (size_t) -1; --i) {
-        if (op->data[i] != 0) {
-            /* find right-most non-zero bit */
-            for (int b = 30; b >= 0; --b) {
-                if ((op->data[i] & (1U << b)) != 0)
-                    return 31 * i + b + 1;
-            }
-        }
+        if (op->data[i] != 0)
+            return 31 * i + 32 - clz32(op->data[i]);
     }
 
     return 0;
@@ -0,0 +1,219 @@
+/* CRC32C (Castagnoli, reflected polynomial 0x82f63b78) */
+
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "crc32c_table.h"
+
+/*
+ * crc32c_update() picks the fastest of:
+ *
+ * - slice-by-16, the default: 16 bytes per step through 16 lookups in the
+ *   tables of crc32c_table.h, which quiz4/test1.c -s generates. Slice-by-8
+ *   is kept next to it for comparison.
+ * - the SSE4.2 crc32 instruction, on x86-64 CPUs that also have PCLMULQDQ.
+ *   crc32 takes 3 cycles but can start every cycle, so one dependent chain
+ *   leaves it two thirds idle. Long buffers are cut into three blocks whose
+ *   CRCs run interleaved and are then merged: each partial CRC is moved
+ *   past the bytes that follow it by a carry-less multiply with a constant
+ *   x^(8n - 33) mod P, and the crc32 instruction reduces the product.
+ *
+ * The CRC follows the usual convention, so that crc32c_update(0, "123456789",
+ * 9) is 0xe3069283: the register starts as all ones and ends inverted, and
+ * the value passed in is that of the bytes before, 0 to start.
+ */
+
+#define CRC32C_POLY 0x82f63b78
+
+/* a * b modulo P, both reflected: bit 31 is x^0 */
+static inline uint32_t _crc32c_multmodp(uint32_t a, uint32_t b)
+{
+    uint32_t m = 1U << 31, p = 0;
+
+    for (;;) {
+        if (a & m) {
+            p ^= b;
+            if (!(a & (m - 1)))
+                break;
+        }
+        m >>= 1;
+        b = (b >> 1) ^ (-(b & 1) & CRC32C_POLY);
+    }
+    return p;
+}
+
+/* x^n modulo P, reflected */
+static inline uint32_t _crc32c_xpow(uint64_t n)
+{
+    uint32_t p = 1U << 31, sq = 1U << 30; /* x^0 and x^1 */
+
+    for (; n; n >>= 1) {
+        if (n & 1)
+            p = _crc32c_multmodp(sq, p);
+        sq = _crc32c_multmodp(sq, sq);
+    }
+    return p;
+}
+
+static inline uint32_t _crc32c_bytewise(uint32_t crc,
+                                        const unsigned char *p,
+                                        size_t len)
+{
+    while (len--)
+        crc = (crc >> 8) ^ crc32c_table[0][(crc ^ *p++) & 0xff];
+    return crc;
+}
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+static inline uint32_t _crc32c_slice8(uint32_t crc,
+                                      const unsigned char *p,
+                                      size_t len)
+{
+    const uint32_t(*t)[256] = crc32c_table;
+
+    for (; len >= 8; p += 8, len -= 8) {
+        uint64_t w;
+        memcpy(&w, p, 8);
+        w ^= crc;
+        crc = t[7][w & 0xff] ^ t[6][(w >> 8) & 0xff] ^
+              t[5][(w >> 16) & 0xff] ^ t[4][(w >> 24) & 0xff] ^
+              t[3][(w >> 32) & 0xff] ^ t[2][(w >> 40) & 0xff] ^
+              t[1][(w >> 48) & 0xff] ^ t[0][w >> 56];
+    }
+    return _crc32c_bytewise(crc, p, len);
+}
+
+static inline uint32_t _crc32c_slice16(uint32_t crc,
+                                       const unsigned char *p,
+                                       size_t len)
+{
+    const uint32_t(*t)[256] = crc32c_table;
+
+    for (; len >= 16; p += 16, len -= 16) {
+        uint64_t w0, w1;
+        memcpy(&w0, p, 8);
+        memcpy(&w1, p + 8, 8);
+        w0 ^= crc;
+        crc = t[15][w0 & 0xff] ^ t[14][(w0 >> 8) & 0xff] ^
+              t[13][(w0 >> 16) & 0xff] ^ t[12][(w0 >> 24) & 0xff] ^
+              t[11][(w0 >> 32) & 0xff] ^ t[10][(w0 >> 40) & 0xff] ^
+              t[9][(w0 >> 48) & 0xff] ^ t[8][w0 >> 56] ^
+              t[7][w1 & 0xff] ^ t[6][(w1 >> 8) & 0xff] ^
+              t[5][(w1 >> 16) & 0xff] ^ t[4][(w1 >> 24) & 0xff] ^
+              t[3][(w1 >> 32) & 0xff] ^ t[2][(w1 >> 40) & 0xff] ^
+              t[1][(w1 >> 48) & 0xff] ^ t[0][w1 >> 56];
+    }
+    return _crc32c_slice8(crc, p, len);
+}
+#else
+/* The slices read words in little-endian order */
+#define _crc32c_slice8 _crc32c_bytewise
+#define _crc32c_slice16 _crc32c_bytewise
+#endif
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+
+#define CRC32C_SIMD 1
+
+/* Bytes per stream of the interleaved loops, and x^(8n - 33) mod P for
+ * n = one and two of them, which test-crc32c.c checks against
+ * _crc32c_xpow().
+ */
+#define CRC32C_LONG 4096
+#define CRC32C_LONG_K1 0x82f89c77
+#define CRC32C_LONG_K2 0x54a86326
+#define CRC32C_SHORT 256
+#define CRC32C_SHORT_K1 0xb9e02b86
+#define CRC32C_SHORT_K2 0xdd7e3b0c
+
+/* crc moved past @k's worth of zero bytes */
+static inline __attribute__((always_inline, target("sse4.2,pclmul")))
+uint64_t _crc32c_shift(uint64_t crc, uint32_t k)
+{
+    __m128i t = _mm_clmulepi64_si128(_mm_cvtsi64_si128(crc),
+                                     _mm_cvtsi32_si128(k), 0);
+    return _mm_crc32_u64(0, _mm_cvtsi128_si64(t));
+}
+
+/* Three consecutive blocks of @block bytes, one chain each */
+static inline __attribute__((always_inline, target("sse4.2,pclmul")))
+uint32_t _crc32c_3way(uint32_t crc,
+                      const unsigned char *p,
+                      size_t block,
+                      uint32_t k1,
+                      uint32_t k2)
+{
+    uint64_t c0 = crc, c1 = 0, c2 = 0;
+
+    for (size_t i = 0; i < block; i += 8) {
+        uint64_t w0, w1, w2;
+        memcpy(&w0, p + i, 8);
+        memcpy(&w1, p + block + i, 8);
+        memcpy(&w2, p + 2 * block + i, 8);
+        c0 = _mm_crc32_u64(c0, w0);
+        c1 = _mm_crc32_u64(c1, w1);
+        c2 = _mm_crc32_u64(c2, w2);
+    }
+    return _crc32c_shift(c0, k2) ^ _crc32c_shift(c1, k1) ^ c2;
+}
+
+__attribute__((target("sse4.2,pclmul"))) static inline uint32_t
+_crc32c_sse42(uint32_t crc, const unsigned char *p, size_t len)
+{
+    for (; len >= 3 * CRC32C_LONG; p += 3 * CRC32C_LONG, len -= 3 * CRC32C_LONG)
+        crc = _crc32c_3way(crc, p, CRC32C_LONG, CRC32C_LONG_K1,
+                           CRC32C_LONG_K2);
+    for (; len >= 3 * CRC32C_SHORT;
+         p += 3 * CRC32C_SHORT, len -= 3 * CRC32C_SHORT)
+        crc = _crc32c_3way(crc, p, CRC32C_SHORT, CRC32C_SHORT_K1,
+                           CRC32C_SHORT_K2);
+
+    uint64_t c = crc;
+    for (; len >= 8; p += 8, len -= 8) {
+        uint64_t w;
+        memcpy(&w, p, 8);
+        c = _mm_crc32_u64(c, w);
+    }
+    crc = c;
+    while (len--)
+        crc = _mm_crc32_u8(crc, *p++);
+    return crc;
+}
+#endif
+
+/**
+ * Extends a CRC32C over more bytes.
+ *
+ * @crc : CRC32C of the bytes before, or 0 to start.
+ * @buf : Next bytes.
+ * @len : Number of bytes.
+ * Return the CRC32C of all the bytes so far.
+ */
+static inline uint32_t crc32c_update(uint32_t crc, const void *buf, size_t len)
+{
+#ifdef CRC32C_SIMD
+    if (__builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("pclmul"))
+        return ~_crc32c_sse42(~crc, buf, len);
+#endif
+    return ~_crc32c_slice16(~crc, buf, len);
+}
+
+/**
+ * Computes the CRC32C of two buffers end to end from the CRC32C of each.
+ *
+ * @crc1 : CRC32C of the first buffer.
+ * @crc2 : CRC32C of the second buffer.
+ * @len2 : Length of the second buffer.
+ * Return the CRC32C of the first buffer followed by the second.
+ */
+static inline uint32_t crc32c_combine(uint32_t crc1, uint32_t crc2, size_t len2)
+{
+    return _crc32c_multmodp(_crc32c_xpow(8 * (uint64_t) len2), crc1) ^ crc2;
+}
+
+#endif /* CRC32C_H */
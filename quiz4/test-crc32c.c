@@ -0,0 +1,212 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../common/rng.h"
+#include "crc32c.h"
+
+#define my_assert(test, message) \
+    do {                         \
+        if (!(test))             \
+            return message;      \
+    } while (0)
+#define my_run_test(test)       \
+    do {                        \
+        char *message = test(); \
+        tests_run++;            \
+        if (message)            \
+            return message;     \
+    } while (0)
+
+/* Every path, on the inverted register like crc32c_update() passes it */
+typedef struct {
+    const char *name;
+    uint32_t (*fn)(uint32_t, const unsigned char *, size_t);
+} path_t;
+
+static path_t paths[5];
+static int npaths;
+
+/* One bit at a time, straight from the polynomial */
+static uint32_t ref_crc32c(uint32_t crc, const unsigned char *p, size_t len)
+{
+    crc = ~crc;
+    while (len--) {
+        crc ^= *p++;
+        for (int j = 0; j < 8; j++)
+            crc = (crc >> 1) ^ (-(crc & 1) & CRC32C_POLY);
+    }
+    return ~crc;
+}
+
+static const char *failed;
+static size_t failed_off, failed_len;
+
+static int check(const unsigned char *p, size_t len, uint32_t crc)
+{
+    uint32_t want = ref_crc32c(crc, p, len);
+
+    failed_off = (uintptr_t) p & 15;
+    failed_len = len;
+    for (int i = 0; i < npaths; i++) {
+        if (~paths[i].fn(~crc, p, len) != want) {
+            failed = paths[i].name;
+            return 0;
+        }
+    }
+    failed = "crc32c_update";
+    return crc32c_update(crc, p, len) == want;
+}
+
+static char *report(void)
+{
+    static char msg[128];
+    snprintf(msg, sizeof(msg), "%s wrong at offset %zu, length %zu", failed,
+             failed_off, failed_len);
+    return msg;
+}
+
+static unsigned char buf[1 << 16];
+
+static char *test_vectors(void)
+{
+    /* RFC 3720, B.4, and the usual check value */
+    static const struct {
+        int fill; /* -1 ascending, -2 descending, -3 "123456789" */
+        size_t len;
+        uint32_t crc;
+    } v[] = {
+        {0x00, 32, 0x8a9136aa}, {0xff, 32, 0x62a8ab43}, {-1, 32, 0x46dd794e},
+        {-2, 32, 0x113fdb5c},   {-3, 9, 0xe3069283},    {0x00, 0, 0},
+    };
+
+    for (size_t i = 0; i < sizeof(v) / sizeof(v[0]); i++) {
+        for (size_t j = 0; j < v[i].len; j++)
+            buf[j] = v[i].fill >= 0 ? (size_t) v[i].fill
+                     : v[i].fill == -1 ? j
+                     : v[i].fill == -2 ? 31 - j
+                                       : '1' + j;
+        my_assert(ref_crc32c(0, buf, v[i].len) == v[i].crc,
+                  "reference disagrees with a test vector");
+        if (!check(buf, v[i].len, 0))
+            return report();
+    }
+    return NULL;
+}
+
+static char *test_table(void)
+{
+    /* crc32c_table.h is what quiz4/test1.c -s prints */
+    for (uint32_t i = 0; i < 256; i++) {
+        unsigned char z[16] = {i};
+        for (int k = 0; k < 16; k++) {
+            /* Byte i then k zero bytes, with no inversion on either side */
+            my_assert(~ref_crc32c(~0U, z, k + 1) == crc32c_table[k][i],
+                      "crc32c_table.h is stale; regenerate it");
+        }
+    }
+    return NULL;
+}
+
+static char *test_lengths(void)
+{
+    rng_t r;
+
+    /* Every length across the tails of all loops, at every alignment,
+     * then random lengths through the interleaved blocks.
+     */
+    rng_seed(&r, 50);
+    for (size_t i = 0; i < sizeof(buf); i++)
+        buf[i] = rng_next(&r);
+    for (size_t off = 0; off < 16; off++) {
+        for (size_t len = 0; len <= 3 * CRC32C_SHORT + 64; len++) {
+            if (!check(buf + off, len, (uint32_t) rng_next(&r)))
+                return report();
+        }
+    }
+    for (int round = 0; round < 300; round++) {
+        size_t len = rng_bounded(&r, sizeof(buf) - 16);
+        if (!check(buf + rng_bounded(&r, 16), len, 0))
+            return report();
+    }
+    return check(buf, sizeof(buf), 0) ? NULL : report();
+}
+
+static char *test_streaming(void)
+{
+    rng_t r;
+
+    /* Any split of a buffer gives the CRC of the whole, whether the parts
+     * are chained through crc32c_update() or merged by crc32c_combine().
+     */
+    rng_seed(&r, 51);
+    uint32_t whole = crc32c_update(0, buf, sizeof(buf));
+    for (int round = 0; round < 1000; round++) {
+        size_t a = rng_bounded(&r, sizeof(buf) + 1);
+        size_t b = a + rng_bounded(&r, sizeof(buf) - a + 1);
+        uint32_t c1 = crc32c_update(0, buf, a);
+        uint32_t c2 = crc32c_update(0, buf + a, b - a);
+        uint32_t c3 = crc32c_update(0, buf + b, sizeof(buf) - b);
+
+        my_assert(crc32c_update(crc32c_update(c1, buf + a, b - a), buf + b,
+                                sizeof(buf) - b) == whole,
+                  "chained updates differ from one pass");
+        my_assert(crc32c_combine(crc32c_combine(c1, c2, b - a), c3,
+                                 sizeof(buf) - b) == whole,
+                  "crc32c_combine differs from one pass");
+    }
+    return NULL;
+}
+
+static char *test_constants(void)
+{
+    /* x^(8n - 33): the multiply adds x^1 and the crc32 reduction x^32 */
+#ifdef CRC32C_SIMD
+    my_assert(_crc32c_xpow(8 * CRC32C_LONG - 33) == CRC32C_LONG_K1 &&
+                  _crc32c_xpow(16 * CRC32C_LONG - 33) == CRC32C_LONG_K2 &&
+                  _crc32c_xpow(8 * CRC32C_SHORT - 33) == CRC32C_SHORT_K1 &&
+                  _crc32c_xpow(16 * CRC32C_SHORT - 33) == CRC32C_SHORT_K2,
+              "interleave constants do not match their powers of x");
+#endif
+    my_assert(_crc32c_xpow(0) == 1U << 31 && _crc32c_xpow(31) == 1,
+              "_crc32c_xpow wrong for small powers");
+    /* x^32 = P without its top term */
+    my_assert(_crc32c_xpow(32) == CRC32C_POLY, "_crc32c_xpow(32) != P");
+    return NULL;
+}
+
+int tests_run = 0;
+
+static char *test_suite(void)
+{
+    my_run_test(test_vectors);
+    my_run_test(test_table);
+    my_run_test(test_constants);
+    my_run_test(test_lengths);
+    my_run_test(test_streaming);
+    return NULL;
+}
+
+int main(void)
+{
+    paths[npaths++] = (path_t){"bytewise", _crc32c_bytewise};
+    paths[npaths++] = (path_t){"slice-by-8", _crc32c_slice8};
+    paths[npaths++] = (path_t){"slice-by-16", _crc32c_slice16};
+#ifdef CRC32C_SIMD
+    if (__builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("pclmul"))
+        paths[npaths++] = (path_t){"SSE4.2", _crc32c_sse42};
+#endif
+
+    printf("---=[ crc32c tests (");
+    for (int p = 0; p < npaths; p++)
+        printf("%s%s", p ? ", " : "", paths[p].name);
+    printf(")\n");
+    char *result = test_suite();
+    if (result)
+        printf("ERROR: %s\n", result);
+    else
+        printf("ALL TESTS PASSED\n");
+    printf("Tests run: %d\n", tests_run);
+    return !!result;
+}
@@ -16,7 +16,42 @@ void generate() {
     printf("};\n");
 }
 
-int main(void)
+/* The byte-at-a-time table, and the tables of slice-by-16: slice k gives
+ * the CRC of a byte followed by k zero bytes. This is crc32c_table.h.
+ */
+void generate_slices(void)
 {
-    generate();
-}
\ No newline at end of file
+    static uint32_t t[16][256];
+
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (uint32_t j = 0; j < 8; j++)
+            crc = (crc >> 1) ^ (-(int)(crc & 1) & POLY);
+        t[0][i] = crc;
+    }
+    for (size_t k = 1; k < 16; k++) {
+        for (size_t i = 0; i < 256; i++)
+            t[k][i] = (t[k - 1][i] >> 8) ^ t[0][t[k - 1][i] & 0xff];
+    }
+
+    printf("/* Generated by quiz4/test1.c -s; do not edit */\n\n");
+    printf("#ifndef CRC32C_TABLE_H\n#define CRC32C_TABLE_H\n\n");
+    printf("#include <stdint.h>\n\n");
+    printf("static const uint32_t crc32c_table[16][256] = {\n");
+    for (size_t k = 0; k < 16; k++) {
+        printf("    {\n");
+        for (size_t i = 0; i < 256; i++)
+            printf("%s0x%08X%s", (i % 6 == 0) ? "        " : " ", t[k][i],
+                   (i % 6 == 5 || i == 255) ? ",\n" : ",");
+        printf("    },\n");
+    }
+    printf("};\n\n#endif /* CRC32C_TABLE_H */\n");
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1 && !strcmp(argv[1], "-s"))
+        generate_slices();
+    else
+        generate();
+}
@@ -0,0 +1,195 @@
+/* Read-mostly workload: mutex-protected map vs. lockless-lookup cmap
+ *
+ * Usage: bench-cmap [readers] [seconds]
+ *
+ * Half of the keys are stable and must always be found; the writer keeps
+ * erasing and re-inserting the other half. Build with -fsanitize=address to
+ * check that no reader ever touches a reclaimed node.
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "cmap.h"
+
+#define NKEYS 4096
+
+typedef struct {
+    cmap_node_t cnode;
+    map_node_t node;
+    long key;
+} entry_t;
+
+static map_t lmap;
+static pthread_mutex_t lmap_lock = PTHREAD_MUTEX_INITIALIZER;
+static cmap_t cmap;
+static atomic_int stop;
+static int use_cmap;
+
+static int long_cmp(void *a, void *b)
+{
+    long x = *(long *) a, y = *(long *) b;
+    return (x > y) - (x < y);
+}
+
+static void *map_get_key(map_node_t *node)
+{
+    return &container_of(node, entry_t, node)->key;
+}
+
+static void *cmap_get_key(cmap_node_t *node)
+{
+    return &container_of(node, entry_t, cnode)->key;
+}
+
+static void cmap_free_entry(cmap_node_t *node)
+{
+    free(container_of(node, entry_t, cnode));
+}
+
+static entry_t *entry_new(long key)
+{
+    entry_t *e = malloc(sizeof(entry_t));
+    assert(e);
+    e->key = key;
+    return e;
+}
+
+static void *reader(void *arg)
+{
+    unsigned long *lookups = arg, n = 0;
+    unsigned seed = (unsigned) (uintptr_t) arg;
+    cmap_reader_t *r = use_cmap ? cmap_reader_register(&cmap) : NULL;
+
+    assert(!use_cmap || r);
+    while (!atomic_load_explicit(&stop, memory_order_relaxed)) {
+        long key = rand_r(&seed) % NKEYS;
+        long found;
+
+        if (use_cmap) {
+            cmap_read_lock(r);
+            cmap_node_t *cn = cmap_find(&cmap, &key);
+            found = cn ? container_of(cn, entry_t, cnode)->key : -1;
+            cmap_read_unlock(r);
+        } else {
+            pthread_mutex_lock(&lmap_lock);
+            map_node_t *node = map_find(&lmap, &key);
+            found = node ? container_of(node, entry_t, node)->key : -1;
+            pthread_mutex_unlock(&lmap_lock);
+        }
+        /* Even keys are never erased. */
+        assert(found == key || (found == -1 && (key & 1)));
+        n++;
+    }
+    if (r)
+        cmap_reader_unregister(r);
+    *lookups = n;
+    return NULL;
+}
+
+static void *writer(void *arg)
+{
+    unsigned long *updates = arg, n = 0;
+    unsigned seed = 42;
+
+    while (!atomic_load_explicit(&stop, memory_order_relaxed)) {
+        long key = (rand_r(&seed) % (NKEYS / 2)) * 2 + 1;
+
+        if (use_cmap) {
+            pthread_mutex_lock(&cmap.lock);
+            cmap_node_t *cn = cmap_find_locked(&cmap, &key);
+            if (cn) {
+                cmap_erase_locked(&cmap, cn);
+            } else {
+                entry_t *e = entry_new(key);
+                cmap_push_locked(&cmap, &e->key, &e->cnode);
+            }
+            pthread_mutex_unlock(&cmap.lock);
+        } else {
+            pthread_mutex_lock(&lmap_lock);
+            map_node_t *node = map_find(&lmap, &key);
+            if (node) {
+                map_erase(&lmap, node);
+                free(container_of(node, entry_t, node));
+            } else {
+                entry_t *e = entry_new(key);
+                map_push(&lmap, &e->key, &e->node);
+            }
+            pthread_mutex_unlock(&lmap_lock);
+        }
+        n++;
+        usleep(100); /* updates are rare */
+    }
+    *updates = n;
+    return NULL;
+}
+
+static void run(int nreaders, int seconds)
+{
+    pthread_t tids[nreaders], wtid;
+    unsigned long lookups[nreaders], updates, total = 0;
+
+    for (long k = 0; k < NKEYS; k++) {
+        entry_t *e = entry_new(k);
+        if (use_cmap)
+            cmap_push(&cmap, &e->key, &e->cnode);
+        else
+            map_push(&lmap, &e->key, &e->node);
+    }
+
+    atomic_store(&stop, 0);
+    for (int i = 0; i < nreaders; i++)
+        pthread_create(&tids[i], NULL, reader, &lookups[i]);
+    pthread_create(&wtid, NULL, writer, &updates);
+    sleep(seconds);
+    atomic_store(&stop, 1);
+    for (int i = 0; i < nreaders; i++) {
+        pthread_join(tids[i], NULL);
+        total += lookups[i];
+    }
+    pthread_join(wtid, NULL);
+
+    printf("%-6s %3d readers: %12.0f lookups/s, %8lu updates\n",
+           use_cmap ? "cmap" : "mutex", nreaders, (double) total / seconds,
+           updates);
+
+    if (use_cmap) {
+        struct rb_node *rn;
+        pthread_mutex_lock(&cmap.lock);
+        while ((rn = cmap.tree[0].rb_node)) {
+            cmap_node_t *cn = container_of(rn, cmap_node_t, rb[0]);
+            rb_erase(&cn->rb[0], &cmap.tree[0]);
+            rb_erase(&cn->rb[1], &cmap.tree[1]);
+            cmap_free_entry(cn);
+        }
+        pthread_mutex_unlock(&cmap.lock);
+        cmap_reclaim(&cmap);
+    } else {
+        map_node_t *node, *next;
+        map_foreach_safe(node, next, &lmap)
+        {
+            map_erase(&lmap, node);
+            free(container_of(node, entry_t, node));
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int nreaders = argc > 1 ? atoi(argv[1]) : 64;
+    int seconds = argc > 2 ? atoi(argv[2]) : 2;
+
+    map_init(&lmap, map_get_key, long_cmp);
+    cmap_init(&cmap, cmap_get_key, long_cmp, cmap_free_entry);
+
+    use_cmap = 0;
+    run(nreaders, seconds);
+    use_cmap = 1;
+    run(nreaders, seconds);
+    return 0;
+}
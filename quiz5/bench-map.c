@@ -0,0 +1,143 @@
+/* Lookup and scan throughput: red-black map vs. B+-tree map
+ *
+ * Usage: bench-map [number of keys]
+ */
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "bptree.h"
+#include "map.h"
+
+typedef struct {
+    map_node_t node;
+    int64_t key;
+} rb_entry_t;
+
+static void *rb_get_key(map_node_t *node)
+{
+    return &container_of(node, rb_entry_t, node)->key;
+}
+
+static int rb_cmp(void *a, void *b)
+{
+    int64_t x = *(int64_t *) a, y = *(int64_t *) b;
+    return (x > y) - (x < y);
+}
+
+static inline uint64_t splitmix64(uint64_t *s)
+{
+    uint64_t z = (*s += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void report(const char *name, const char *op, size_t n, double sec)
+{
+    printf("%-7s %-7s %8.1f ns/op %10.2f Mops/s\n", name, op, sec * 1e9 / n,
+           n / sec / 1e6);
+}
+
+int main(int argc, char **argv)
+{
+    size_t n = argc > 1 ? strtoul(argv[1], NULL, 0) : 1000000;
+    uint64_t seed = 1;
+
+    /* The shuffle below counts down from n - 1 */
+    if (!n) {
+        fprintf(stderr, "Usage: %s [number of keys > 0]\n", argv[0]);
+        return 1;
+    }
+    int64_t *keys = malloc(n * sizeof(int64_t));
+    rb_entry_t *entries = malloc(n * sizeof(rb_entry_t));
+    assert(keys && entries);
+
+    for (size_t i = 0; i < n; i++)
+        keys[i] = (int64_t) splitmix64(&seed);
+
+    map_t rb;
+    bmap_t bt;
+    map_init(&rb, rb_get_key, rb_cmp);
+    bmap_init(&bt);
+
+    double t = now();
+    for (size_t i = 0; i < n; i++) {
+        entries[i].key = keys[i];
+        map_push(&rb, &entries[i].key, &entries[i].node);
+    }
+    report("rbtree", "insert", n, now() - t);
+
+    t = now();
+    for (size_t i = 0; i < n; i++)
+        bmap_push(&bt, keys[i], &entries[i]);
+    report("bptree", "insert", n, now() - t);
+
+    /* Look the keys up in a different order than they were inserted. */
+    for (size_t i = n - 1; i > 0; i--) {
+        size_t j = splitmix64(&seed) % (i + 1);
+        int64_t tmp = keys[i];
+        keys[i] = keys[j];
+        keys[j] = tmp;
+    }
+
+    size_t hits = 0;
+    t = now();
+    for (size_t i = 0; i < n; i++)
+        hits += !!map_find(&rb, &keys[i]);
+    report("rbtree", "find", n, now() - t);
+    assert(hits == n);
+
+    hits = 0;
+    t = now();
+    for (size_t i = 0; i < n; i++)
+        hits += !!bmap_find(&bt, keys[i]);
+    report("bptree", "find", n, now() - t);
+    assert(hits == n);
+
+    int64_t prev = INT64_MIN;
+    uint64_t sum_rb = 0, sum_bt = 0;
+    map_node_t *node;
+    t = now();
+    map_foreach(node, &rb) sum_rb += container_of(node, rb_entry_t, node)->key;
+    report("rbtree", "scan", n, now() - t);
+
+    bmap_iter_t it;
+    size_t count = 0;
+    t = now();
+    bmap_foreach(&it, &bt) sum_bt += bmap_iter_key(&it);
+    report("bptree", "scan", n, now() - t);
+    assert(sum_rb == sum_bt);
+
+    /* Both maps must agree on order and contents after erasing half. */
+    for (size_t i = 0; i < n / 2; i++) {
+        map_erase(&rb, map_find(&rb, &keys[i]));
+        void *val = bmap_erase(&bt, keys[i]);
+        assert(val && ((rb_entry_t *) val)->key == keys[i]);
+        assert(!bmap_find(&bt, keys[i]));
+    }
+    node = map_first(&rb);
+    bmap_foreach(&it, &bt) {
+        assert(bmap_iter_key(&it) > prev);
+        assert(bmap_iter_key(&it) == container_of(node, rb_entry_t, node)->key);
+        prev = bmap_iter_key(&it);
+        node = map_next(node);
+        count++;
+    }
+    assert(!node && count == bmap_size(&bt) && count == n - n / 2);
+
+    bmap_destroy(&bt);
+    free(entries);
+    free(keys);
+    return 0;
+}
@@ -0,0 +1,406 @@
+/* Cache-conscious ordered map backed by a B+-tree */
+
+#ifndef BPTREE_H
+#define BPTREE_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+/*
+ * The red-black map in map.h touches one rb_node (and one key through
+ * key_pt) per level, so a lookup over millions of keys costs roughly 2*log2(n)
+ * cache misses. This map keeps the keys of a node packed in a contiguous
+ * array sized to whole cache lines and searches them with a handful of SIMD
+ * compares, so each level costs a couple of adjacent lines instead.
+ *
+ * Keys are 64-bit signed integers: a user callback per comparison would defeat
+ * the in-node vector search. Values live in the leaves, which are chained so
+ * that an in-order scan is a walk over dense arrays.
+ */
+
+#define BMAP_CACHELINE 64
+
+/* Number of keys per node. 16 int64_t keys fill exactly two cache lines. */
+#define BMAP_KEYS 16
+
+/* Every node except the root keeps at least BMAP_MIN keys. */
+#define BMAP_MIN (BMAP_KEYS / 2 - 1)
+
+typedef struct bmap_node {
+    int64_t keys[BMAP_KEYS];
+    union {
+        void *vals[BMAP_KEYS];                  /* leaf */
+        struct bmap_node *child[BMAP_KEYS + 1]; /* internal */
+    };
+    struct bmap_node *next; /* next leaf in key order */
+    int n;
+    int leaf;
+} __attribute__((aligned(BMAP_CACHELINE))) bmap_node_t;
+
+typedef struct {
+    bmap_node_t *root;
+    size_t size;
+} bmap_t;
+
+typedef struct {
+    bmap_node_t *leaf;
+    int idx;
+} bmap_iter_t;
+
+#define bmap_size(map) ((map)->size)
+#define bmap_empty(map) (!(map)->size)
+
+#define bmap_iter_key(it) ((it)->leaf->keys[(it)->idx])
+#define bmap_iter_val(it) ((it)->leaf->vals[(it)->idx])
+
+#define bmap_foreach(it, m) \
+    for (bmap_first(m, it); (it)->leaf; bmap_next(it))
+
+/* Return the number of keys in @node that are less than @key (or less than or
+ * equal to it when @inclusive is set). Unused slots are masked off, so their
+ * contents do not matter.
+ */
+static inline int bmap_rank(const bmap_node_t *node, int64_t key, int inclusive)
+{
+    if (inclusive && key == INT64_MAX)
+        return node->n;
+
+    int64_t k = key + !!inclusive; /* x <= key  <=>  x < key + 1 */
+    uint32_t live = (1U << node->n) - 1;
+
+#if defined(__AVX512F__)
+    __m512i needle = _mm512_set1_epi64(k);
+    uint32_t lt = 0;
+    for (int i = 0; i < BMAP_KEYS; i += 8) {
+        __m512i v = _mm512_load_si512((const void *) &node->keys[i]);
+        lt |= (uint32_t) _mm512_cmplt_epi64_mask(v, needle) << i;
+    }
+    return __builtin_popcount(lt & live);
+#elif defined(__AVX2__)
+    __m256i needle = _mm256_set1_epi64x(k);
+    uint32_t lt = 0;
+    for (int i = 0; i < BMAP_KEYS; i += 4) {
+        __m256i v = _mm256_load_si256((const __m256i *) &node->keys[i]);
+        __m256i gt = _mm256_cmpgt_epi64(needle, v);
+        lt |= (uint32_t) _mm256_movemask_pd(_mm256_castsi256_pd(gt)) << i;
+    }
+    return __builtin_popcount(lt & live);
+#else
+    /* Branchless linear scan; the whole array is two cache lines anyway. */
+    int r = 0;
+    for (int i = 0; i < BMAP_KEYS; i++)
+        r += (node->keys[i] < k) & (live >> i);
+    return r;
+#endif
+}
+
+static inline bmap_node_t *bmap_node_new(int leaf)
+{
+    bmap_node_t *node = aligned_alloc(BMAP_CACHELINE, sizeof(bmap_node_t));
+    if (!node)
+        return NULL;
+    memset(node, 0, sizeof(*node));
+    node->leaf = leaf;
+    return node;
+}
+
+/**
+ * Initializes an empty map.
+ *
+ * @map : Pointer to the map to initialize.
+ */
+static inline void bmap_init(bmap_t *map)
+{
+    map->root = NULL;
+    map->size = 0;
+}
+
+/**
+ * Searches the map for @key.
+ *
+ * @map : Pointer to the map.
+ * @key : Key to search for.
+ * Return Pointer to the value slot if found, NULL otherwise.
+ */
+static inline void **bmap_find(const bmap_t *map, int64_t key)
+{
+    bmap_node_t *node = map->root;
+    if (!node)
+        return NULL;
+
+    while (!node->leaf)
+        node = node->child[bmap_rank(node, key, 1)];
+
+    int i = bmap_rank(node, key, 0);
+    if (i < node->n && node->keys[i] == key)
+        return &node->vals[i];
+    return NULL;
+}
+
+/* Split the full child @i of @parent in two halves. @parent must not be full.
+ */
+static inline int bmap_split_child(bmap_node_t *parent, int i)
+{
+    bmap_node_t *c = parent->child[i];
+    bmap_node_t *r = bmap_node_new(c->leaf);
+    int64_t sep;
+    int half = BMAP_KEYS / 2;
+
+    if (!r)
+        return -1;
+
+    if (c->leaf) {
+        /* Both halves keep their keys; the separator is copied up. */
+        r->n = BMAP_KEYS - half;
+        memcpy(r->keys, &c->keys[half], r->n * sizeof(int64_t));
+        memcpy(r->vals, &c->vals[half], r->n * sizeof(void *));
+        r->next = c->next;
+        c->next = r;
+        c->n = half;
+        sep = r->keys[0];
+    } else {
+        /* The middle key moves up and is removed from both halves. */
+        r->n = BMAP_KEYS - half - 1;
+        memcpy(r->keys, &c->keys[half + 1], r->n * sizeof(int64_t));
+        memcpy(r->child, &c->child[half + 1],
+               (r->n + 1) * sizeof(bmap_node_t *));
+        c->n = half;
+        sep = c->keys[half];
+    }
+
+    memmove(&parent->keys[i + 1], &parent->keys[i],
+            (parent->n - i) * sizeof(int64_t));
+    memmove(&parent->child[i + 2], &parent->child[i + 1],
+            (parent->n - i) * sizeof(bmap_node_t *));
+    parent->keys[i] = sep;
+    parent->child[i + 1] = r;
+    parent->n++;
+    return 0;
+}
+
+/**
+ * Inserts @key with its associated @val into the map. Full nodes are split on
+ * the way down, so the insertion never has to walk back up the tree.
+ *
+ * @map : Pointer to the map.
+ * @key : Key to insert.
+ * @val : Value associated with the key.
+ * Return 0 on successful insertion, -1 if a duplicate key is found or memory
+ * is exhausted.
+ */
+static inline int bmap_push(bmap_t *map, int64_t key, void *val)
+{
+    if (!map->root && !(map->root = bmap_node_new(1)))
+        return -1;
+
+    if (map->root->n == BMAP_KEYS) {
+        bmap_node_t *root = bmap_node_new(0);
+        if (!root)
+            return -1;
+        root->child[0] = map->root;
+        if (bmap_split_child(root, 0) < 0) {
+            free(root);
+            return -1;
+        }
+        map->root = root;
+    }
+
+    bmap_node_t *node = map->root;
+    while (!node->leaf) {
+        int i = bmap_rank(node, key, 1);
+        if (node->child[i]->n == BMAP_KEYS) {
+            if (bmap_split_child(node, i) < 0)
+                return -1;
+            if (key >= node->keys[i])
+                i++;
+        }
+        node = node->child[i];
+    }
+
+    int i = bmap_rank(node, key, 0);
+    if (i < node->n && node->keys[i] == key)
+        return -1; /* Duplicate key */
+
+    memmove(&node->keys[i + 1], &node->keys[i],
+            (node->n - i) * sizeof(int64_t));
+    memmove(&node->vals[i + 1], &node->vals[i], (node->n - i) * sizeof(void *));
+    node->keys[i] = key;
+    node->vals[i] = val;
+    node->n++;
+    map->size++;
+    return 0;
+}
+
+/* Move one entry from the left sibling of child @i into it. */
+static inline void bmap_borrow_left(bmap_node_t *p, int i)
+{
+    bmap_node_t *c = p->child[i], *l = p->child[i - 1];
+
+    memmove(&c->keys[1], &c->keys[0], c->n * sizeof(int64_t));
+    if (c->leaf) {
+        memmove(&c->vals[1], &c->vals[0], c->n * sizeof(void *));
+        c->keys[0] = l->keys[l->n - 1];
+        c->vals[0] = l->vals[l->n - 1];
+        p->keys[i - 1] = c->keys[0];
+    } else {
+        memmove(&c->child[1], &c->child[0], (c->n + 1) * sizeof(void *));
+        c->keys[0] = p->keys[i - 1];
+        c->child[0] = l->child[l->n];
+        p->keys[i - 1] = l->keys[l->n - 1];
+    }
+    c->n++;
+    l->n--;
+}
+
+/* Move one entry from the right sibling of child @i into it. */
+static inline void bmap_borrow_right(bmap_node_t *p, int i)
+{
+    bmap_node_t *c = p->child[i], *r = p->child[i + 1];
+
+    if (c->leaf) {
+        c->keys[c->n] = r->keys[0];
+        c->vals[c->n] = r->vals[0];
+        memmove(&r->vals[0], &r->vals[1], (r->n - 1) * sizeof(void *));
+        memmove(&r->keys[0], &r->keys[1], (r->n - 1) * sizeof(int64_t));
+        p->keys[i] = r->keys[0];
+    } else {
+        c->keys[c->n] = p->keys[i];
+        c->child[c->n + 1] = r->child[0];
+        p->keys[i] = r->keys[0];
+        memmove(&r->keys[0], &r->keys[1], (r->n - 1) * sizeof(int64_t));
+        memmove(&r->child[0], &r->child[1], r->n * sizeof(void *));
+    }
+    c->n++;
+    r->n--;
+}
+
+/* Fold child @i + 1 of @p into child @i and drop their separator. */
+static inline void bmap_merge(bmap_node_t *p, int i)
+{
+    bmap_node_t *c = p->child[i], *r = p->child[i + 1];
+
+    if (c->leaf) {
+        memcpy(&c->keys[c->n], r->keys, r->n * sizeof(int64_t));
+        memcpy(&c->vals[c->n], r->vals, r->n * sizeof(void *));
+        c->n += r->n;
+        c->next = r->next;
+    } else {
+        c->keys[c->n] = p->keys[i];
+        memcpy(&c->keys[c->n + 1], r->keys, r->n * sizeof(int64_t));
+        memcpy(&c->child[c->n + 1], r->child, (r->n + 1) * sizeof(void *));
+        c->n += r->n + 1;
+    }
+    free(r);
+
+    memmove(&p->keys[i], &p->keys[i + 1], (p->n - i - 1) * sizeof(int64_t));
+    memmove(&p->child[i + 1], &p->child[i + 2],
+            (p->n - i - 1) * sizeof(bmap_node_t *));
+    p->n--;
+}
+
+/**
+ * Removes @key from the map. Nodes at minimum occupancy are refilled from a
+ * sibling (or merged with it) before descending into them, so the removal
+ * never has to walk back up the tree.
+ *
+ * @map : Pointer to the map.
+ * @key : Key to remove.
+ * Return the value that was associated with @key, NULL if it was not found.
+ */
+static inline void *bmap_erase(bmap_t *map, int64_t key)
+{
+    bmap_node_t *node = map->root;
+    if (!node)
+        return NULL;
+
+    while (!node->leaf) {
+        int i = bmap_rank(node, key, 1);
+
+        if (node->child[i]->n <= BMAP_MIN) {
+            if (i > 0 && node->child[i - 1]->n > BMAP_MIN) {
+                bmap_borrow_left(node, i);
+            } else if (i < node->n && node->child[i + 1]->n > BMAP_MIN) {
+                bmap_borrow_right(node, i);
+            } else {
+                bmap_merge(node, i == node->n ? i - 1 : i);
+                if (node == map->root && !node->n) {
+                    /* The root lost its last separator: shrink the tree. */
+                    map->root = node->child[0];
+                    free(node);
+                    node = map->root;
+                    continue;
+                }
+            }
+            /* Separators around the child moved; route again. */
+            i = bmap_rank(node, key, 1);
+        }
+        node = node->child[i];
+    }
+
+    int i = bmap_rank(node, key, 0);
+    if (i >= node->n || node->keys[i] != key)
+        return NULL;
+
+    void *val = node->vals[i];
+    memmove(&node->keys[i], &node->keys[i + 1],
+            (node->n - i - 1) * sizeof(int64_t));
+    memmove(&node->vals[i], &node->vals[i + 1],
+            (node->n - i - 1) * sizeof(void *));
+    node->n--;
+    map->size--;
+    return val;
+}
+
+/* Position @it on the smallest key; it->leaf is NULL for an empty map. */
+static inline void bmap_first(const bmap_t *map, bmap_iter_t *it)
+{
+    bmap_node_t *node = map->root;
+    it->idx = 0;
+    it->leaf = NULL;
+    if (!node)
+        return;
+    while (!node->leaf)
+        node = node->child[0];
+    while (node && !node->n)
+        node = node->next;
+    it->leaf = node;
+}
+
+/* Advance @it in key order. */
+static inline void bmap_next(bmap_iter_t *it)
+{
+    if (++it->idx < it->leaf->n)
+        return;
+    it->idx = 0;
+    do
+        it->leaf = it->leaf->next;
+    while (it->leaf && !it->leaf->n);
+}
+
+static inline void bmap_free_node(bmap_node_t *node)
+{
+    if (!node->leaf) {
+        for (int i = 0; i <= node->n; i++)
+            bmap_free_node(node->child[i]);
+    }
+    free(node);
+}
+
+/**
+ * Releases every node of the map. Values are owned by the caller.
+ *
+ * @map : Pointer to the map.
+ */
+static inline void bmap_destroy(bmap_t *map)
+{
+    if (map->root)
+        bmap_free_node(map->root);
+    bmap_init(map);
+}
+
+#endif /* BPTREE_H */
@@ -0,0 +1,341 @@
+/* Read-mostly concurrent ordered map: latched red-black trees with lockless
+ * lookups
+ */
+
+#ifndef CMAP_H
+#define CMAP_H
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+
+#include "map.h"
+
+/*
+ * Writers serialize on a mutex; readers never take it. Every entry is linked
+ * into two red-black trees, and a sequence count selects which copy readers
+ * should use (the "latch" technique of the Linux kernel's latch_tree):
+ *
+ *   seq++  -> readers move to tree[1];  writer updates tree[0]
+ *   seq++  -> readers move to tree[0];  writer updates tree[1]
+ *
+ * A reader thus always walks a tree that is not being modified, unless it was
+ * overtaken by a whole update while walking; the sequence check catches that
+ * and the lookup is retried. Depth is bounded so that even a walk over a tree
+ * torn by such an overtaking update terminates.
+ *
+ * Nodes unlinked by cmap_erase() may still be referenced by readers, so they
+ * are retired and only freed once every reader that might have seen them has
+ * left its read-side critical section (a grace period, as in RCU).
+ */
+
+#define CMAP_MAX_READERS 128
+
+/* No red-black tree that fits in memory is deeper than this. */
+#define CMAP_MAX_DEPTH 128
+
+/* Retired nodes are reclaimed in batches of this size. */
+#define CMAP_RETIRE_BATCH 64
+
+#define CMAP_READ_ONCE(x) (*(volatile __typeof__(x) *) &(x))
+
+typedef struct cmap_node {
+    struct rb_node rb[2];
+    struct cmap_node *retired_next;
+} cmap_node_t;
+
+typedef void *(*cmap_key_pt)(cmap_node_t *);
+typedef void (*cmap_free_pt)(cmap_node_t *);
+
+/* Per-thread reader state. The counter is odd while inside a read section. */
+typedef struct {
+    _Atomic unsigned long ctr;
+    _Atomic int used;
+} __attribute__((aligned(64))) cmap_reader_t;
+
+typedef struct {
+    struct rb_root tree[2];
+    _Atomic unsigned seq;
+    pthread_mutex_t lock;
+    cmap_key_pt key_pt;
+    map_cmp_pt cmp_pt;
+    cmap_free_pt free_pt;
+    cmap_node_t *retired;
+    size_t nretired;
+    cmap_reader_t readers[CMAP_MAX_READERS];
+} cmap_t;
+
+#define cmap_data(ptr, type, member) container_of(ptr, type, member)
+
+/**
+ * Initializes the concurrent map.
+ *
+ * @map : Pointer to the map to initialize.
+ * @key_pt : Function pointer to extract the key from a node.
+ * @cmp_pt : Function pointer for key comparison. If NULL, a default
+ * strcmp-based comparator is used.
+ * @free_pt : Called on each erased node once no reader can reach it any more.
+ */
+static inline void cmap_init(cmap_t *map,
+                             cmap_key_pt key_pt,
+                             map_cmp_pt cmp_pt,
+                             cmap_free_pt free_pt)
+{
+    map->tree[0].rb_node = map->tree[1].rb_node = NULL;
+    atomic_init(&map->seq, 0);
+    pthread_mutex_init(&map->lock, NULL);
+    map->key_pt = key_pt;
+    map->cmp_pt = cmp_pt ? cmp_pt : _map_def_cmp;
+    map->free_pt = free_pt;
+    map->retired = NULL;
+    map->nretired = 0;
+    for (int i = 0; i < CMAP_MAX_READERS; i++) {
+        atomic_init(&map->readers[i].ctr, 0);
+        atomic_init(&map->readers[i].used, 0);
+    }
+}
+
+/**
+ * Claims a reader slot for the calling thread.
+ *
+ * Return the slot to pass to cmap_read_lock()/cmap_read_unlock(), NULL if all
+ * CMAP_MAX_READERS slots are taken.
+ */
+static inline cmap_reader_t *cmap_reader_register(cmap_t *map)
+{
+    for (int i = 0; i < CMAP_MAX_READERS; i++) {
+        int expected = 0;
+        if (atomic_compare_exchange_strong(&map->readers[i].used, &expected,
+                                           1))
+            return &map->readers[i];
+    }
+    return NULL;
+}
+
+static inline void cmap_reader_unregister(cmap_reader_t *r)
+{
+    atomic_store(&r->used, 0);
+}
+
+/* Nodes returned by cmap_find() stay valid until the matching unlock. */
+static inline void cmap_read_lock(cmap_reader_t *r)
+{
+    /* Full barrier: the odd counter is visible before any tree load. */
+    atomic_fetch_add(&r->ctr, 1);
+}
+
+static inline void cmap_read_unlock(cmap_reader_t *r)
+{
+    atomic_fetch_add_explicit(&r->ctr, 1, memory_order_release);
+}
+
+/**
+ * Searches the map without taking the writer lock. Must be called inside
+ * cmap_read_lock()/cmap_read_unlock().
+ *
+ * @map Pointer to the map.
+ * @key Pointer to the key to search for.
+ * Return Pointer to the matching node if found, NULL otherwise.
+ */
+static inline cmap_node_t *cmap_find(cmap_t *map, void *key)
+{
+    cmap_node_t *found;
+    unsigned seq;
+
+    do {
+        seq = atomic_load_explicit(&map->seq, memory_order_acquire);
+        int idx = seq & 1;
+        struct rb_node *node = CMAP_READ_ONCE(map->tree[idx].rb_node);
+
+        found = NULL;
+        for (int depth = 0; node && depth < CMAP_MAX_DEPTH; depth++) {
+            cmap_node_t *cn = container_of(node, cmap_node_t, rb[idx]);
+            int rc = map->cmp_pt(key, map->key_pt(cn));
+            if (rc < 0) {
+                node = CMAP_READ_ONCE(node->rb_left);
+            } else if (rc > 0) {
+                node = CMAP_READ_ONCE(node->rb_right);
+            } else {
+                found = cn;
+                break;
+            }
+        }
+        atomic_thread_fence(memory_order_acquire);
+    } while (atomic_load_explicit(&map->seq, memory_order_relaxed) != seq);
+
+    return found;
+}
+
+/**
+ * Searches the map from the writer side. The caller holds map->lock, so the
+ * node stays valid until it is unlocked and can be passed to
+ * cmap_erase_locked().
+ *
+ * @map : Pointer to the map.
+ * @key : Pointer to the key to search for.
+ * Return Pointer to the matching node if found, NULL otherwise.
+ */
+static inline cmap_node_t *cmap_find_locked(cmap_t *map, void *key)
+{
+    struct rb_node *node = map->tree[0].rb_node;
+
+    while (node) {
+        cmap_node_t *cn = container_of(node, cmap_node_t, rb[0]);
+        int rc = map->cmp_pt(key, map->key_pt(cn));
+        if (rc < 0)
+            node = node->rb_left;
+        else if (rc > 0)
+            node = node->rb_right;
+        else
+            return cn;
+    }
+    return NULL;
+}
+
+/* Switch readers over to the other copy. */
+static inline void cmap_latch(cmap_t *map)
+{
+    atomic_thread_fence(memory_order_release);
+    atomic_fetch_add_explicit(&map->seq, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+}
+
+static inline int cmap_tree_push(cmap_t *map,
+                                 int idx,
+                                 void *key,
+                                 cmap_node_t *node)
+{
+    struct rb_node **pnode = &map->tree[idx].rb_node;
+    struct rb_node *parent = NULL;
+
+    while (*pnode) {
+        int rc = map->cmp_pt(key, map->key_pt(
+                                      container_of(*pnode, cmap_node_t, rb[idx])));
+        parent = *pnode;
+        if (rc < 0)
+            pnode = &(*pnode)->rb_left;
+        else if (rc > 0)
+            pnode = &(*pnode)->rb_right;
+        else
+            return -1; /* Duplicate key */
+    }
+
+    rb_link_node(&node->rb[idx], parent, pnode);
+    rb_insert_color(&node->rb[idx], &map->tree[idx]);
+    return 0;
+}
+
+/* cmap_push() with the writer lock already held */
+static inline int cmap_push_locked(cmap_t *map, void *key, cmap_node_t *node)
+{
+    int rc;
+
+    cmap_latch(map);
+    rc = cmap_tree_push(map, 0, key, node);
+    if (!rc) {
+        cmap_latch(map);
+        cmap_tree_push(map, 1, key, node);
+    }
+    return rc;
+}
+
+/**
+ * Inserts a node with the specified key. Duplicate keys are not allowed.
+ *
+ * @map : Pointer to the map.
+ * @key : Pointer to the key.
+ * @node : Pointer to the node to insert.
+ * Return 0 on successful insertion, -1 if a duplicate key is found.
+ */
+static inline int cmap_push(cmap_t *map, void *key, cmap_node_t *node)
+{
+    int rc;
+
+    pthread_mutex_lock(&map->lock);
+    rc = cmap_push_locked(map, key, node);
+    pthread_mutex_unlock(&map->lock);
+    return rc;
+}
+
+/* Wait until every reader that was inside a read section has left it. */
+static inline void cmap_synchronize(cmap_t *map)
+{
+    atomic_thread_fence(memory_order_seq_cst);
+    for (int i = 0; i < CMAP_MAX_READERS; i++) {
+        unsigned long v = atomic_load(&map->readers[i].ctr);
+        if (!(v & 1))
+            continue;
+        while (atomic_load(&map->readers[i].ctr) == v)
+            sched_yield();
+    }
+}
+
+/* Free every node retired so far. Called with the writer lock held. */
+static inline void cmap_reclaim_locked(cmap_t *map)
+{
+    cmap_node_t *list = map->retired;
+
+    if (!list)
+        return;
+    map->retired = NULL;
+    map->nretired = 0;
+
+    cmap_synchronize(map);
+    while (list) {
+        cmap_node_t *next = list->retired_next;
+        if (map->free_pt)
+            map->free_pt(list);
+        list = next;
+    }
+}
+
+/* cmap_erase() with the writer lock already held */
+static inline void cmap_erase_locked(cmap_t *map, cmap_node_t *node)
+{
+    cmap_latch(map);
+    rb_erase(&node->rb[0], &map->tree[0]);
+    cmap_latch(map);
+    rb_erase(&node->rb[1], &map->tree[1]);
+
+    node->retired_next = map->retired;
+    map->retired = node;
+    if (++map->nretired >= CMAP_RETIRE_BATCH)
+        cmap_reclaim_locked(map);
+}
+
+/**
+ * Removes the specified node from the map. The node is handed to free_pt only
+ * after a grace period, in batches of CMAP_RETIRE_BATCH nodes.
+ *
+ * @map : Pointer to the map.
+ * @node : Pointer to the node to remove.
+ */
+static inline void cmap_erase(cmap_t *map, cmap_node_t *node)
+{
+    pthread_mutex_lock(&map->lock);
+    cmap_erase_locked(map, node);
+    pthread_mutex_unlock(&map->lock);
+}
+
+/* Force reclamation of all retired nodes, e.g. before tearing the map down. */
+static inline void cmap_reclaim(cmap_t *map)
+{
+    pthread_mutex_lock(&map->lock);
+    cmap_reclaim_locked(map);
+    pthread_mutex_unlock(&map->lock);
+}
+
+/* In-order traversal. Writers must be excluded (hold map->lock), since only the
+ * lookup path is lockless.
+ */
+#define cmap_foreach(n, m)                                                 \
+    for ((n) = rb_first(&(m)->tree[0])                                     \
+                   ? container_of(rb_first(&(m)->tree[0]), cmap_node_t, rb[0]) \
+                   : NULL;                                                 \
+         (n); (n) = rb_next(&(n)->rb[0])                                   \
+                        ? container_of(rb_next(&(n)->rb[0]), cmap_node_t,  \
+                                       rb[0])                              \
+                        : NULL)
+
+#endif /* CMAP_H */
@@ -0,0 +1,475 @@
+/* Persistent ordered map: path-copying red-black tree with O(1) snapshots */
+
+#ifndef PMAP_H
+#define PMAP_H
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include "map.h"
+
+/*
+ * The intrusive rb_node of map.h carries a parent pointer, so a node can only
+ * ever belong to one tree. Here nodes are immutable once shared and carry no
+ * parent pointer: an update rebuilds only the O(log n) nodes on the path from
+ * the root to the change and points the new path at the untouched subtrees of
+ * the old version. A snapshot is just another reference to the root.
+ *
+ * Every node is reference counted (one count per parent node or per map whose
+ * root it is). Dropping a version releases exactly the nodes no other version
+ * shares. Insertion is Okasaki's functional red-black insert, deletion is
+ * Kahrs' functional delete.
+ *
+ * Keys and values are not owned by the map: an entry erased from one version
+ * can still be reached through older snapshots.
+ *
+ * Each version (each pmap_t) belongs to one thread at a time, but different
+ * versions may be used, updated and released on different threads at once:
+ * the reference counts they share are atomic, and a node is only changed in
+ * place while its count shows no other version can see it. A snapshot is
+ * taken on the thread that owns the map it copies and can then be handed
+ * to another.
+ */
+
+/* No red-black tree that fits in memory is deeper than this. */
+#define PMAP_MAX_DEPTH 128
+
+/* Unique nodes freed by an update are kept for the next ones. */
+#define PMAP_CACHE_SIZE 64
+
+typedef struct pmap_node {
+    struct pmap_node *left, *right;
+    void *key;
+    void *val;
+    unsigned long ref;
+    int color;
+} pmap_node_t;
+
+typedef struct {
+    pmap_node_t *root;
+    map_cmp_pt cmp_pt;
+    size_t size;
+    pmap_node_t *cache; /* recycled nodes, chained through ->left */
+    int ncache;
+} pmap_t;
+
+typedef struct {
+    pmap_node_t *stack[PMAP_MAX_DEPTH];
+    int depth;
+} pmap_iter_t;
+
+#define pmap_size(map) ((map)->size)
+#define pmap_empty(map) (!(map)->root)
+
+#define pmap_iter_key(it) ((it)->stack[(it)->depth - 1]->key)
+#define pmap_iter_val(it) ((it)->stack[(it)->depth - 1]->val)
+
+#define pmap_foreach(it, m) \
+    for (pmap_first(m, it); (it)->depth; pmap_next(it))
+
+#define PN_RED(n) ((n) && (n)->color == RB_RED)
+#define PN_BLACK(n) ((n) && (n)->color == RB_BLACK)
+
+/* All helpers below take ownership of the node references they are passed
+ * and return an owned reference.
+ */
+
+static inline pmap_node_t *pn_get(pmap_node_t *n)
+{
+    if (n)
+        __atomic_add_fetch(&n->ref, 1, __ATOMIC_RELAXED);
+    return n;
+}
+
+/* Nonzero if no other version can reach @n, so it may be changed in place */
+static inline int pn_unique(pmap_node_t *n)
+{
+    return __atomic_load_n(&n->ref, __ATOMIC_ACQUIRE) == 1;
+}
+
+static void pn_put(pmap_t *map, pmap_node_t *n)
+{
+    /* The last release must see every other version's writes to the node */
+    while (n && !__atomic_sub_fetch(&n->ref, 1, __ATOMIC_ACQ_REL)) {
+        pmap_node_t *right = n->right;
+        pn_put(map, n->left);
+        if (map->ncache < PMAP_CACHE_SIZE) {
+            n->left = map->cache;
+            map->cache = n;
+            map->ncache++;
+        } else {
+            free(n);
+        }
+        n = right;
+    }
+}
+
+static pmap_node_t *pn_new(pmap_t *map,
+                           int color,
+                           pmap_node_t *left,
+                           void *key,
+                           void *val,
+                           pmap_node_t *right)
+{
+    pmap_node_t *n = map->cache;
+
+    if (n) {
+        map->cache = n->left;
+        map->ncache--;
+    } else if (!(n = malloc(sizeof(pmap_node_t)))) {
+        abort();
+    }
+    n->left = left;
+    n->right = right;
+    n->key = key;
+    n->val = val;
+    n->ref = 1;
+    n->color = color;
+    return n;
+}
+
+/* Take the contents of @n apart: the caller gets references to both children
+ * and gives up its reference to @n.
+ */
+#define PN_OPEN(map, n, l, k, v, r)   \
+    do {                              \
+        pmap_node_t *__n = (n);       \
+        (l) = pn_get(__n->left);      \
+        (r) = pn_get(__n->right);     \
+        (k) = __n->key;               \
+        (v) = __n->val;               \
+        pn_put(map, __n);             \
+    } while (0)
+
+/* Kahrs' balance: rebuild a black node over a, kv, b, resolving a red-red
+ * violation on either side.
+ */
+static pmap_node_t *pn_balance(pmap_t *map,
+                               pmap_node_t *a,
+                               void *k,
+                               void *v,
+                               pmap_node_t *b)
+{
+    pmap_node_t *x, *y, *z, *w;
+    void *xk, *xv, *yk, *yv;
+
+    if (PN_RED(a) && PN_RED(b)) {
+        PN_OPEN(map, a, x, xk, xv, y);
+        PN_OPEN(map, b, z, yk, yv, w);
+        return pn_new(map, RB_RED, pn_new(map, RB_BLACK, x, xk, xv, y), k, v,
+                      pn_new(map, RB_BLACK, z, yk, yv, w));
+    }
+    if (PN_RED(a) && PN_RED(a->left)) {
+        PN_OPEN(map, a, x, yk, yv, z);
+        PN_OPEN(map, x, x, xk, xv, y);
+        return pn_new(map, RB_RED, pn_new(map, RB_BLACK, x, xk, xv, y), yk, yv,
+                      pn_new(map, RB_BLACK, z, k, v, b));
+    }
+    if (PN_RED(a) && PN_RED(a->right)) {
+        PN_OPEN(map, a, x, xk, xv, z);
+        PN_OPEN(map, z, y, yk, yv, z);
+        return pn_new(map, RB_RED, pn_new(map, RB_BLACK, x, xk, xv, y), yk, yv,
+                      pn_new(map, RB_BLACK, z, k, v, b));
+    }
+    if (PN_RED(b) && PN_RED(b->right)) {
+        PN_OPEN(map, b, x, xk, xv, z);
+        PN_OPEN(map, z, y, yk, yv, w);
+        return pn_new(map, RB_RED, pn_new(map, RB_BLACK, a, k, v, x), xk, xv,
+                      pn_new(map, RB_BLACK, y, yk, yv, w));
+    }
+    if (PN_RED(b) && PN_RED(b->left)) {
+        PN_OPEN(map, b, x, yk, yv, w);
+        PN_OPEN(map, x, x, xk, xv, y);
+        return pn_new(map, RB_RED, pn_new(map, RB_BLACK, a, k, v, x), xk, xv,
+                      pn_new(map, RB_BLACK, y, yk, yv, w));
+    }
+    return pn_new(map, RB_BLACK, a, k, v, b);
+}
+
+/* Repaint a black node red (Kahrs' sub1). */
+static pmap_node_t *pn_redden(pmap_t *map, pmap_node_t *n)
+{
+    pmap_node_t *l, *r;
+    void *k, *v;
+
+    assert(PN_BLACK(n));
+    PN_OPEN(map, n, l, k, v, r);
+    return pn_new(map, RB_RED, l, k, v, r);
+}
+
+static pmap_node_t *pn_blacken(pmap_t *map, pmap_node_t *n)
+{
+    pmap_node_t *l, *r;
+    void *k, *v;
+
+    if (!PN_RED(n))
+        return n;
+    if (pn_unique(n)) { /* fresh from this update, nobody else sees it */
+        n->color = RB_BLACK;
+        return n;
+    }
+    PN_OPEN(map, n, l, k, v, r);
+    return pn_new(map, RB_BLACK, l, k, v, r);
+}
+
+static pmap_node_t *pn_insert(pmap_t *map, pmap_node_t *t, void *k, void *v)
+{
+    pmap_node_t *l, *r;
+    void *tk, *tv;
+
+    if (!t)
+        return pn_new(map, RB_RED, NULL, k, v, NULL);
+
+    int lt = map->cmp_pt(k, t->key) < 0;
+    int color = t->color;
+    PN_OPEN(map, t, l, tk, tv, r);
+    if (lt)
+        l = pn_insert(map, l, k, v);
+    else
+        r = pn_insert(map, r, k, v);
+    if (color == RB_BLACK)
+        return pn_balance(map, l, tk, tv, r);
+    return pn_new(map, RB_RED, l, tk, tv, r);
+}
+
+/* @l has a black height one less than @r. */
+static pmap_node_t *pn_balleft(pmap_t *map,
+                               pmap_node_t *l,
+                               void *k,
+                               void *v,
+                               pmap_node_t *r)
+{
+    pmap_node_t *a, *b, *c;
+    void *yk, *yv, *zk, *zv;
+
+    if (PN_RED(l))
+        return pn_new(map, RB_RED, pn_blacken(map, l), k, v, r);
+    if (PN_BLACK(r))
+        return pn_balance(map, l, k, v, pn_redden(map, r));
+
+    assert(PN_RED(r) && PN_BLACK(r->left));
+    PN_OPEN(map, r, a, zk, zv, c);
+    PN_OPEN(map, a, a, yk, yv, b);
+    return pn_new(map, RB_RED, pn_new(map, RB_BLACK, l, k, v, a), yk, yv,
+                  pn_balance(map, b, zk, zv, pn_redden(map, c)));
+}
+
+/* @r has a black height one less than @l. */
+static pmap_node_t *pn_balright(pmap_t *map,
+                                pmap_node_t *l,
+                                void *k,
+                                void *v,
+                                pmap_node_t *r)
+{
+    pmap_node_t *a, *b, *c;
+    void *xk, *xv, *yk, *yv;
+
+    if (PN_RED(r))
+        return pn_new(map, RB_RED, l, k, v, pn_blacken(map, r));
+    if (PN_BLACK(l))
+        return pn_balance(map, pn_redden(map, l), k, v, r);
+
+    assert(PN_RED(l) && PN_BLACK(l->right));
+    PN_OPEN(map, l, a, xk, xv, c);
+    PN_OPEN(map, c, b, yk, yv, c);
+    return pn_new(map, RB_RED, pn_balance(map, pn_redden(map, a), xk, xv, b),
+                  yk, yv, pn_new(map, RB_BLACK, c, k, v, r));
+}
+
+/* Join two trees of equal black height whose keys are all a < all b. */
+static pmap_node_t *pn_append(pmap_t *map, pmap_node_t *a, pmap_node_t *b)
+{
+    pmap_node_t *al, *ar, *bl, *br, *bc, *x, *y;
+    void *ak, *av, *bk, *bv, *zk, *zv;
+
+    if (!a)
+        return b;
+    if (!b)
+        return a;
+
+    if (PN_RED(a) && PN_RED(b)) {
+        PN_OPEN(map, a, al, ak, av, ar);
+        PN_OPEN(map, b, bl, bk, bv, br);
+        bc = pn_append(map, ar, bl);
+        if (PN_RED(bc)) {
+            PN_OPEN(map, bc, x, zk, zv, y);
+            return pn_new(map, RB_RED, pn_new(map, RB_RED, al, ak, av, x), zk,
+                          zv, pn_new(map, RB_RED, y, bk, bv, br));
+        }
+        return pn_new(map, RB_RED, al, ak, av,
+                      pn_new(map, RB_RED, bc, bk, bv, br));
+    }
+    if (PN_BLACK(a) && PN_BLACK(b)) {
+        PN_OPEN(map, a, al, ak, av, ar);
+        PN_OPEN(map, b, bl, bk, bv, br);
+        bc = pn_append(map, ar, bl);
+        if (PN_RED(bc)) {
+            PN_OPEN(map, bc, x, zk, zv, y);
+            return pn_new(map, RB_RED, pn_new(map, RB_BLACK, al, ak, av, x), zk,
+                          zv, pn_new(map, RB_BLACK, y, bk, bv, br));
+        }
+        return pn_balleft(map, al, ak, av,
+                          pn_new(map, RB_BLACK, bc, bk, bv, br));
+    }
+    if (PN_RED(b)) {
+        PN_OPEN(map, b, bl, bk, bv, br);
+        return pn_new(map, RB_RED, pn_append(map, a, bl), bk, bv, br);
+    }
+    PN_OPEN(map, a, al, ak, av, ar);
+    return pn_new(map, RB_RED, al, ak, av, pn_append(map, ar, b));
+}
+
+/* Remove @k, which must be present in @t; its value is stored in @val. */
+static pmap_node_t *pn_delete(pmap_t *map,
+                              pmap_node_t *t,
+                              void *k,
+                              void **val)
+{
+    pmap_node_t *l, *r;
+    void *tk, *tv;
+
+    int rc = map->cmp_pt(k, t->key);
+    PN_OPEN(map, t, l, tk, tv, r);
+    if (rc < 0) {
+        if (PN_BLACK(l))
+            return pn_balleft(map, pn_delete(map, l, k, val), tk, tv, r);
+        return pn_new(map, RB_RED, pn_delete(map, l, k, val), tk, tv, r);
+    }
+    if (rc > 0) {
+        if (PN_BLACK(r))
+            return pn_balright(map, l, tk, tv, pn_delete(map, r, k, val));
+        return pn_new(map, RB_RED, l, tk, tv, pn_delete(map, r, k, val));
+    }
+    *val = tv;
+    return pn_append(map, l, r);
+}
+
+/**
+ * Initializes an empty persistent map.
+ *
+ * @map : Pointer to the map to initialize.
+ * @cmp_pt : Function pointer for key comparison. If NULL, a default
+ * strcmp-based comparator is used.
+ */
+static inline void pmap_init(pmap_t *map, map_cmp_pt cmp_pt)
+{
+    map->root = NULL;
+    map->cmp_pt = cmp_pt ? cmp_pt : _map_def_cmp;
+    map->size = 0;
+    map->cache = NULL;
+    map->ncache = 0;
+}
+
+/**
+ * Searches the map for a key.
+ *
+ * @map Pointer to the map.
+ * @key Pointer to the key to search for.
+ * Return Pointer to the matching node if found, NULL otherwise.
+ */
+static inline pmap_node_t *pmap_find(const pmap_t *map, void *key)
+{
+    pmap_node_t *node = map->root;
+    while (node) {
+        int rc = map->cmp_pt(key, node->key);
+        if (rc < 0)
+            node = node->left;
+        else if (rc > 0)
+            node = node->right;
+        else
+            return node;
+    }
+    return NULL;
+}
+
+/**
+ * Inserts a key/value pair. Only the path from the root to the new entry is
+ * copied; snapshots taken earlier are not affected.
+ *
+ * @map : Pointer to the map.
+ * @key : Pointer to the key.
+ * @val : Value associated with the key.
+ * Return 0 on successful insertion, -1 if a duplicate key is found.
+ */
+static inline int pmap_push(pmap_t *map, void *key, void *val)
+{
+    if (pmap_find(map, key))
+        return -1; /* Duplicate key */
+    map->root = pn_blacken(map, pn_insert(map, map->root, key, val));
+    map->size++;
+    return 0;
+}
+
+/**
+ * Removes a key from this version of the map. Only the path from the root to
+ * the entry is copied; snapshots taken earlier still contain the entry.
+ *
+ * @map : Pointer to the map.
+ * @key : Pointer to the key to remove.
+ * Return the value that was associated with @key, NULL if it was not found.
+ */
+static inline void *pmap_erase(pmap_t *map, void *key)
+{
+    void *val = NULL;
+
+    if (!pmap_find(map, key))
+        return NULL;
+    map->root = pn_blacken(map, pn_delete(map, map->root, key, &val));
+    map->size--;
+    return val;
+}
+
+/**
+ * Takes a point-in-time snapshot of @map in O(1). Both maps can be updated
+ * independently afterwards; each must eventually be passed to pmap_release().
+ *
+ * @map : Pointer to the map.
+ * @snap : Pointer to the map receiving the snapshot.
+ */
+static inline void pmap_snapshot(const pmap_t *map, pmap_t *snap)
+{
+    pmap_init(snap, map->cmp_pt);
+    snap->root = pn_get(map->root);
+    snap->size = map->size;
+}
+
+/**
+ * Drops this version of the map, freeing every node that no other version
+ * shares.
+ *
+ * @map : Pointer to the map.
+ */
+static inline void pmap_release(pmap_t *map)
+{
+    pn_put(map, map->root);
+    map->root = NULL;
+    map->size = 0;
+    while (map->cache) {
+        pmap_node_t *n = map->cache;
+        map->cache = n->left;
+        free(n);
+    }
+    map->ncache = 0;
+}
+
+static inline void pmap_push_left(pmap_iter_t *it, pmap_node_t *n)
+{
+    for (; n; n = n->left)
+        it->stack[it->depth++] = n;
+}
+
+/* Position @it on the smallest key; it->depth is 0 for an empty map. */
+static inline void pmap_first(const pmap_t *map, pmap_iter_t *it)
+{
+    it->depth = 0;
+    pmap_push_left(it, map->root);
+}
+
+/* Advance @it in key order. */
+static inline void pmap_next(pmap_iter_t *it)
+{
+    pmap_node_t *n = it->stack[--it->depth];
+    pmap_push_left(it, n->right);
+}
+
+#endif /* PMAP_H */
@@ -0,0 +1,227 @@
+/* Randomized test for the persistent map
+ *
+ * Applies random inserts and erases while keeping a ring of snapshots, and
+ * checks after every step that each snapshot still holds exactly the keys it
+ * was taken with and that every version is a valid red-black tree. Then does
+ * the same with a second thread checking and releasing the snapshots while
+ * the first keeps updating the map. Build with -fsanitize=address to also
+ * check that releasing all versions frees every node, or -fsanitize=thread
+ * to check the shared reference counts.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pmap.h"
+
+#define NKEYS 512
+#define NSNAPS 8
+#define NSTEPS 20000
+
+static int keys[NKEYS];
+
+typedef struct {
+    pmap_t map;
+    unsigned char present[NKEYS];
+} version_t;
+
+static int int_cmp(void *a, void *b)
+{
+    return *(int *) a - *(int *) b;
+}
+
+/* Return the black height of @n, or -1 if a red-black property is broken. */
+static int check_rb(pmap_node_t *n, void *lo, void *hi)
+{
+    if (!n)
+        return 1;
+    if ((lo && int_cmp(n->key, lo) <= 0) || (hi && int_cmp(n->key, hi) >= 0))
+        return -1;
+    if (PN_RED(n) && (PN_RED(n->left) || PN_RED(n->right)))
+        return -1;
+    if (!__atomic_load_n(&n->ref, __ATOMIC_RELAXED))
+        return -1;
+
+    int l = check_rb(n->left, lo, n->key);
+    int r = check_rb(n->right, n->key, hi);
+    if (l < 0 || l != r)
+        return -1;
+    return l + (n->color == RB_BLACK);
+}
+
+static const char *check_version(version_t *v)
+{
+    pmap_iter_t it;
+    size_t count = 0;
+    int prev = -1;
+
+    if (PN_RED(v->map.root) || check_rb(v->map.root, NULL, NULL) < 0)
+        return "red-black properties violated";
+
+    pmap_foreach(&it, &v->map) {
+        int k = *(int *) pmap_iter_key(&it);
+        if (k <= prev)
+            return "keys out of order";
+        if (!v->present[k] || pmap_iter_val(&it) != &keys[k])
+            return "unexpected entry";
+        prev = k;
+        count++;
+    }
+    for (int k = 0; k < NKEYS; k++) {
+        if (!!pmap_find(&v->map, &keys[k]) != v->present[k])
+            return "lookup disagrees with contents";
+    }
+    if (count != pmap_size(&v->map))
+        return "size mismatch";
+    return NULL;
+}
+
+/* Apply one random insert or erase to @cur */
+static const char *update(version_t *cur, unsigned *seed)
+{
+    int k = rand_r(seed) % NKEYS;
+
+    if (cur->present[k]) {
+        if (pmap_erase(&cur->map, &keys[k]) != &keys[k])
+            return "erase returned the wrong value";
+        if (pmap_erase(&cur->map, &keys[k]))
+            return "erased key still present";
+        cur->present[k] = 0;
+    } else {
+        if (pmap_push(&cur->map, &keys[k], &keys[k]) != 0)
+            return "push rejected a new key";
+        if (pmap_push(&cur->map, &keys[k], &keys[k]) == 0)
+            return "duplicate key accepted";
+        cur->present[k] = 1;
+    }
+    return NULL;
+}
+
+/* Snapshots handed from the updating thread to the releasing one */
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    version_t *queue[NSNAPS];
+    int head, tail;
+    int done;
+    const char *msg;
+} handoff = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER,
+};
+
+static void *releaser(void *arg)
+{
+    (void) arg;
+    for (;;) {
+        pthread_mutex_lock(&handoff.lock);
+        while (handoff.head == handoff.tail && !handoff.done)
+            pthread_cond_wait(&handoff.cond, &handoff.lock);
+        if (handoff.head == handoff.tail) {
+            pthread_mutex_unlock(&handoff.lock);
+            return NULL;
+        }
+        version_t *v = handoff.queue[handoff.head++ % NSNAPS];
+        pthread_cond_signal(&handoff.cond);
+        pthread_mutex_unlock(&handoff.lock);
+
+        /* The nodes it shares with the live map are being pn_get() and
+         * pn_put() by the other thread meanwhile.
+         */
+        const char *msg = check_version(v);
+        pmap_release(&v->map);
+        free(v);
+        if (msg && !handoff.msg)
+            handoff.msg = msg;
+    }
+}
+
+static const char *test_threaded(void)
+{
+    version_t cur;
+    const char *msg = NULL;
+    unsigned seed = 2;
+    pthread_t t;
+
+    pmap_init(&cur.map, int_cmp);
+    memset(cur.present, 0, sizeof(cur.present));
+    if (pthread_create(&t, NULL, releaser, NULL))
+        return "pthread_create failed";
+
+    for (int step = 0; step < NSTEPS && !msg; step++) {
+        msg = update(&cur, &seed);
+        if (msg || step % 13)
+            continue;
+
+        version_t *s = malloc(sizeof(*s));
+        if (!s) {
+            msg = "out of memory";
+            break;
+        }
+        pmap_snapshot(&cur.map, &s->map);
+        memcpy(s->present, cur.present, NKEYS);
+        pthread_mutex_lock(&handoff.lock);
+        while (handoff.tail - handoff.head == NSNAPS)
+            pthread_cond_wait(&handoff.cond, &handoff.lock);
+        handoff.queue[handoff.tail++ % NSNAPS] = s;
+        pthread_cond_signal(&handoff.cond);
+        pthread_mutex_unlock(&handoff.lock);
+    }
+
+    pthread_mutex_lock(&handoff.lock);
+    handoff.done = 1;
+    pthread_cond_signal(&handoff.cond);
+    pthread_mutex_unlock(&handoff.lock);
+    pthread_join(t, NULL);
+
+    if (!msg)
+        msg = handoff.msg ? handoff.msg : check_version(&cur);
+    pmap_release(&cur.map);
+    return msg;
+}
+
+int main(void)
+{
+    version_t cur, snaps[NSNAPS];
+    const char *msg = NULL;
+    unsigned seed = 1;
+
+    for (int k = 0; k < NKEYS; k++)
+        keys[k] = k;
+    pmap_init(&cur.map, int_cmp);
+    memset(cur.present, 0, sizeof(cur.present));
+    for (int i = 0; i < NSNAPS; i++) {
+        pmap_snapshot(&cur.map, &snaps[i].map);
+        memset(snaps[i].present, 0, NKEYS);
+    }
+
+    for (int step = 0; step < NSTEPS && !msg; step++) {
+        msg = update(&cur, &seed);
+        if (step % 97 == 0) {
+            version_t *s = &snaps[(step / 97) % NSNAPS];
+            pmap_release(&s->map);
+            pmap_snapshot(&cur.map, &s->map);
+            memcpy(s->present, cur.present, NKEYS);
+        }
+        if (!msg && step % 31 == 0) {
+            msg = check_version(&cur);
+            for (int i = 0; i < NSNAPS && !msg; i++)
+                msg = check_version(&snaps[i]);
+        }
+    }
+
+    pmap_release(&cur.map);
+    for (int i = 0; i < NSNAPS; i++)
+        pmap_release(&snaps[i].map);
+    if (!msg)
+        msg = test_threaded();
+
+    printf("---=[ Persistent map tests\n");
+    if (msg)
+        printf("ERROR: %s\n", msg);
+    else
+        printf("ALL TESTS PASSED\n");
+    return !!msg;
+}
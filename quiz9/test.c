@@ -15,8 +15,9 @@
 
 /* Each thread concurrently inserts values into priority buckets using C11
  * atomics. Bucket indices are computed from a stable hash combining value and
- * position. No explicit sorting is used; order emerges from normalized
- * priority-based grouping.
+ * position, normalized so that buckets cover increasing value ranges. Each
+ * bucket then holds a narrow range in arbitrary order, and is finished with
+ * qsort() as it is copied out.
  */
 
 typedef struct {
@@ -39,6 +40,23 @@ typedef struct {
     int end_bucket;
 } worker_ctx_t;
 
+/* Bucket of the element @v at position @i. stable_code * max_priority needs
+ * up to 75 bits; dividing its top bits by @val_range gives the same result as
+ * dividing the whole product by @val_range << 32.
+ */
+static inline size_t bucket_of(int v,
+                               size_t i,
+                               int val_min,
+                               uint64_t val_range,
+                               size_t max_priority)
+{
+    uint64_t stable_code =
+        ((uint64_t) ((uint32_t) v - (uint32_t) val_min) << 32) | i;
+    uint64_t top = ((__uint128_t) stable_code * max_priority) >> 32;
+    size_t norm = top / val_range;
+    return norm < max_priority ? norm : max_priority - 1;
+}
+
 /* Each fill worker thread processes a subset of the input array.
  * It computes the priority bucket index and uses an atomic counter to safely
  * insert.
@@ -49,21 +67,23 @@ void *fill_worker(void *arg)
     size_t stride = N_WORKERS;
 
     for (size_t i = ctx->worker_id; i < ctx->count; i += stride) {
-        uint64_t stable_code =
-            ((uint64_t) (ctx->data[i] - ctx->val_min) << 32) | i;
-        size_t norm = (stable_code * ctx->max_priority) /
-                      ((uint64_t) ctx->val_range << 32);
-        if (norm >= ctx->max_priority)
-            norm = ctx->max_priority - 1;
-
-        size_t index = atomic_fetch_add(ctx->bucket_sizes);
+        size_t norm = bucket_of(ctx->data[i], i, ctx->val_min, ctx->val_range,
+                                ctx->max_priority);
+
+        size_t index = atomic_fetch_add(&ctx->bucket_sizes[norm], 1);
         ctx->buckets[norm][index] = ctx->data[i];
     }
     return NULL;
 }
 
+static int cmp_int(const void *a, const void *b)
+{
+    int x = *(const int *) a, y = *(const int *) b;
+    return (x > y) - (x < y);
+}
+
 /* Each merge worker thread copies its assigned buckets into the final result
- * array.
+ * array and sorts them in place there.
  */
 void *worker_func(void *arg)
 {
@@ -75,6 +95,7 @@ void *worker_func(void *arg)
         size_t offset = ctx->bucket_offsets[p];
         for (size_t i = 0; i < len; i++)
             ctx->result[offset + i] = src[i];
+        qsort(ctx->result + offset, len, sizeof(int), cmp_int);
     }
     return NULL;
 }
@@ -87,9 +108,6 @@ void sched_sort(int *data, size_t count)
     /* Dynamically determine the number of priority buckets */
     size_t max_prio = (count < 512 ? 512 : (count < 4096 ? 1024 : 2048));
 
-    struct timeval t0, t1;
-    gettimeofday(&t0, NULL);
-
     /* Determine the min and max values in the input */
     int val_min = data[0], val_max = data[0];
     for (size_t i = 1; i < count; i++) {
@@ -105,10 +123,11 @@ void sched_sort(int *data, size_t count)
     _Atomic size_t *bucket_sizes = calloc(max_prio, sizeof(_Atomic size_t));
     size_t *bucket_caps = calloc(max_prio, sizeof(size_t));
 
-    for (size_t i = 0; i < max_prio; i++) {
-        bucket_caps[i] = (count / max_prio) * 2 + 8;
+    /* Size every bucket exactly; skewed input would overflow a guess. */
+    for (size_t i = 0; i < count; i++)
+        bucket_caps[bucket_of(data[i], i, val_min, val_range, max_prio)]++;
+    for (size_t i = 0; i < max_prio; i++)
         buckets[i] = malloc(bucket_caps[i] * sizeof(int));
-    }
 
     /* Launch threads for concurrent bucket filling */
     pthread_t fillers[N_WORKERS];
@@ -132,11 +151,11 @@ void sched_sort(int *data, size_t count)
     /* Finalize bucket sizes and compute offsets */
     size_t *bucket_sizes_plain = malloc(sizeof(size_t) * max_prio);
     for (size_t i = 0; i < max_prio; i++)
-        bucket_sizes_plain[i] = atomic_load(fill_ctxs[i].bucket_sizes);
+        bucket_sizes_plain[i] = atomic_load(&bucket_sizes[i]);
 
     size_t *bucket_offsets = calloc(max_prio, sizeof(size_t));
     for (size_t p = 1; p < max_prio; p++)
-        bucket_offsets[p] = bucket_offsets[p - 1] + bucket_sizes_plain[p];
+        bucket_offsets[p] = bucket_offsets[p - 1] + bucket_sizes_plain[p - 1];
 
     /* Launch threads to copy buckets into sorted output */
     int *sorted = malloc(sizeof(int) * count);
@@ -175,10 +194,6 @@ void sched_sort(int *data, size_t count)
     free(bucket_sizes_plain);
     free(bucket_caps);
     free(bucket_offsets);
-
-    gettimeofday(&t1, NULL);
-    long usec = (t1.tv_sec - t0.tv_sec) * 1000000L + (t1.tv_usec - t0.tv_usec);
-    fprintf(stderr, "Elapsed time: %ld us (%.2f ms)\n", usec, usec / 1000.0);
 }
 
 int is_sorted(const int *data, size_t n)
@@ -202,7 +217,12 @@ int main(int argc, const char *argv[])
     for (size_t i = 0; i < count; i++)
         data[i] = atoi(argv[i + 1]);
 
+    struct timeval t0, t1;
+    gettimeofday(&t0, NULL);
     sched_sort(data, count);
+    gettimeofday(&t1, NULL);
+    long usec = (t1.tv_sec - t0.tv_sec) * 1000000L + (t1.tv_usec - t0.tv_usec);
+    fprintf(stderr, "Elapsed time: %ld us (%.2f ms)\n", usec, usec / 1000.0);
 
     if (!is_sorted(data, count)) {
         fprintf(stderr,